@@ -4,18 +4,11 @@
 
 #include "efm32gg.h"
 #include "audio.h"
+#include "synth.h"
 
-int8_t keys_typed = 0x00;
-
-double walltime(void);
-void start_walltime(void);
-void stop_walltime(void);
-void clear_walltime(void);
-
-void play_square(int wave_frequency);
-void play_sawtooth(int wave_frequency);
-void set_current_song(int n);
+volatile int8_t keys_typed = 0x00;
 
+void fill_audio(int half);
 void update_key_controller(void);
 void update_song_controller(void);
 void update_volume_controller(void);
@@ -24,6 +17,10 @@ void update_volume_controller(void);
 
 #define SAMPLE_FREQUENCY (44100)
 
+/* Samples in each half of the audio buffer, one half is played from TIMER1
+   while the main loop renders the other */
+#define AUDIO_HALF 64
+
 /* Extracts bit 'n' from 's' */
 #define BIT(s, n) (((s) >> (n)) & 1U)
 
@@ -31,39 +28,35 @@ enum { SW1, SW2, SW3, SW4, SW5, SW6, SW7 };
 
 enum { SONG1, SONG2, SONG3 };
 
-int8_t volume = 4;
-
-typedef struct Song Song;
-
-struct Song {
-    int *frequency;
-    int *duration;
-    int length;
-} current_song;
+volatile int8_t volume = 4;
 
-int song1_frequency[] = {
-    100, 200, 300, 400, 500, 600, 700, 800, 900
+const Note song1_notes[] = {
+    { 100, 100 }, { 200, 100 }, { 300, 100 }, { 400, 100 }, { 500, 100 },
+    { 600, 100 }, { 700, 100 }, { 800, 100 }, { 900, 100 }
 };
-int song1_duration[] = {
-    100, 100, 100, 100, 100, 100, 100, 100, 100
-};
-int song1_length = 9;
 
-int song2_frequency[] = {
-    900, 800, 700, 600, 500, 400, 300, 200, 100
-};
-int song2_duration[] = {
-    100, 100, 100, 100, 100, 100, 100, 100, 100
+const Note song2_notes[] = {
+    { 900, 100 }, { 800, 100 }, { 700, 100 }, { 600, 100 }, { 500, 100 },
+    { 400, 100 }, { 300, 100 }, { 200, 100 }, { 100, 100 }
 };
-int song2_length = 9;
 
-int song3_frequency[] = {
-    1000, 1200
+const Note song3_notes[] = {
+    { 1000, 100 }, { 1200, 200 }
 };
-int song3_duration[] = {
-    100, 200
+
+const Song songs[] = {
+    { song1_notes, 9, WAVE_SAW, 0 },
+    { song2_notes, 9, WAVE_SAW, 0 },
+    { song3_notes, 2, WAVE_SAW, 0 }
 };
-int song3_length = 2;
+
+Synth synth;
+
+/* DAC codes played from TIMER1, 'half_played' is set to the half it has
+   just finished so the main loop can refill it */
+int16_t audio_buffer[2 * AUDIO_HALF];
+volatile int audio_position = 0;
+volatile int half_played = -1;
 
 int main(void)
 {
@@ -85,18 +78,17 @@ int main(void)
     *DAC0_CH0CTRL = 1;
     *DAC0_CH1CTRL = 1;
 
+    /* Configure synth, both halves are rendered before TIMER1 starts */
+    synth_init(&synth, SAMPLE_FREQUENCY);
+    fill_audio(0);
+    fill_audio(1);
+
     /* Configure TIMER1 */
     *CMU_HFPERCLKEN0 |= (1 << 6);
     *TIMER1_TOP = BASE_FREQUENCY / SAMPLE_FREQUENCY;
     *TIMER1_IEN = 1;
     *TIMER1_CMD = 1;
 
-    /* Configure TIMER2 */
-    *CMU_HFPERCLKEN0 |= (1 << 7);
-    *TIMER2_TOP = ((1 << 16) - 1);
-    *TIMER2_CTRL |= 0xa000000;
-    *TIMER2_CMD = 1;
-
     /* Configure interrupt handling for TIMER1, GPIO_ODD and GPIO_EVEN */
     *ISER0 |= 0x1802;
 
@@ -106,8 +98,22 @@ int main(void)
     *GPIO_EXTIRISE = 0xFF;
     *GPIO_EXTIFALL = 0xFF;
 
-    /* Wait for interrupt */
-    __asm__("wfi");
+    /* Render whichever half TIMER1 has finished, sleep otherwise. TIMER1
+       preempts the rendering, so samples stay evenly spaced as long as a
+       half renders while the other one plays. */
+    while (1)
+    {
+        update_song_controller();
+
+        if (half_played != -1)
+        {
+            int half = half_played;
+            half_played = -1;
+            fill_audio(half);
+        }
+        else
+            __asm__("wfi");
+    }
 
 	return 1;
 }
@@ -115,93 +121,24 @@ int main(void)
 
 /*------------------------------------------------------------------------------
  *
- * Walltime functions
+ * Interrupt controllers
  *
  *----------------------------------------------------------------------------*/
 
 
-/* Clears and starts the walltime */
-void start_walltime(void)
-{
-    *TIMER2_CNT = 0;
-    *TIMER2_CMD = 1;
-}
-
-/* Clears the walltime */
-void clear_walltime(void)
-{
-    *TIMER2_CNT = 0;
-}
-
-/* Stops the walltime */
-void stop_walltime(void)
-{
-    *TIMER2_CMD = 2;
-}
-
-/* Returns the walltime in milliseconds
-
-   The walltime is calculated using TIMER2 with a pre-scale factor of 10 using
-   BASE_FREQUENCY. Thus the theoretical time limit using this function is
-
-       (1000 * (2^16 - 1)) / (BASE_FREQUENCY / 2^10)
-
-   milliseconds.
-*/
-double walltime(void)
-{
-    return (double)(*TIMER2_CNT * 1000 / (BASE_FREQUENCY / (int)(1 << 10)));
-}
-
-void play_square(int wave_frequency)
-{
-    static int x = 0;
-    const int T = SAMPLE_FREQUENCY / wave_frequency;
-    const int H = T / 2;
-
-    int delta = 3;
-
-    if (x < H)
-        delta = 0;
-
-    x = (x + 1) % T;
-
-    *DAC0_CH0DATA = (int16_t)(volume * delta);
-    *DAC0_CH1DATA = (int16_t)(volume * delta);
-}
-
-void play_sawtooth(int wave_frequency)
+/* Plays the next sample, flagging each half of the buffer as it finishes */
+void __attribute__ ((interrupt)) TIMER1_IRQHandler()
 {
-    static int x = 0;
-    const int T = SAMPLE_FREQUENCY / wave_frequency;
-    const int H = T / 4;
-
-    int delta = 3;
+    int position = audio_position;
 
-    if (x < H)
-        delta = 0;
-    else if (x < 2 * H)
-        delta = 1;
-    else if (x < 3 * H)
-        delta = 2;
+    *DAC0_CH0DATA = audio_buffer[position];
+    *DAC0_CH1DATA = audio_buffer[position];
 
-    x = (x + 1) % T;
+    position = (position + 1) % (2 * AUDIO_HALF);
+    if (position % AUDIO_HALF == 0)
+        half_played = 1 - position / AUDIO_HALF;
+    audio_position = position;
 
-    *DAC0_CH0DATA = (int16_t)(volume * delta);
-    *DAC0_CH1DATA = (int16_t)(volume * delta);
-}
-
-
-/*------------------------------------------------------------------------------
- *
- * Interrupt controllers
- *
- *----------------------------------------------------------------------------*/
-
-
-void __attribute__ ((interrupt)) TIMER1_IRQHandler()
-{
-    update_song_controller();
     *TIMER1_IFC = 1;
 }
 
@@ -260,81 +197,37 @@ void update_key_controller(void)
  *----------------------------------------------------------------------------*/
 
 
-void set_current_song(int n)
+/* Renders the next samples into 'half' of the audio buffer as DAC codes
+
+   The synth renders signed 16 bit samples, they are scaled down to about
+   the output range used so far and offset to be positive for the DAC.
+*/
+void fill_audio(int half)
 {
-    switch (n)
-    {
-    case SONG1:
-        current_song.frequency = song1_frequency;
-        current_song.duration = song1_duration;
-        current_song.length = song1_length;
-        break;
-    case SONG2:
-        current_song.frequency = song2_frequency;
-        current_song.duration = song2_duration;
-        current_song.length = song2_length;
-        break;
-    case SONG3:
-        current_song.frequency = song3_frequency;
-        current_song.duration = song3_duration;
-        current_song.length = song3_length;
-        break;
-    }
+    int16_t *samples = &audio_buffer[half * AUDIO_HALF];
+
+    synth_set_volume(&synth, volume * SYNTH_VOLUME_MAX / 8);
+    synth_render(&synth, samples, AUDIO_HALF);
+
+    for (int i = 0; i < AUDIO_HALF; i++)
+        samples[i] = (samples[i] >> 9) + 32;
 }
 
+/* Starts the song picked with SW1 to SW3, called from the main loop */
 void update_song_controller(void)
 {
-    enum { PLAY, IDLE };
+    int8_t typed = keys_typed;
 
-    static int i = 0;
-    static int state = IDLE;
-
-    if (BIT(keys_typed, SW1))
-    {
-        i = 0;
-        set_current_song(SONG1);
-        state = PLAY;
-        start_walltime();
-    }
-    else if (BIT(keys_typed, SW2))
-    {
-        i = 0;
-        set_current_song(SONG2);
-        state = PLAY;
-        start_walltime();
-    }
-    else if (BIT(keys_typed, SW3))
-    {
-        i = 0;
-        set_current_song(SONG3);
-        state = PLAY;
-        start_walltime();
-    }
+    if (BIT(typed, SW1))
+        synth_play(&synth, 0, &songs[SONG1]);
+    else if (BIT(typed, SW2))
+        synth_play(&synth, 0, &songs[SONG2]);
+    else if (BIT(typed, SW3))
+        synth_play(&synth, 0, &songs[SONG3]);
+    else
+        return;
 
     keys_typed = 0x00;
-
-    switch (state)
-    {
-    case IDLE:
-        break;
-    case PLAY:
-        if (walltime() < current_song.duration[i])
-        {
-            play_sawtooth(current_song.frequency[i]);
-        }
-        else
-        {
-            clear_walltime();
-            i++;
-            if (i > current_song.length - 1)
-            {
-                i = 0;
-                state = IDLE;
-                stop_walltime();
-            }
-        }
-        break;
-    }
 }
 
 
@@ -6,6 +6,19 @@
 #include <linux/cdev.h>
 #include <linux/fs.h>
 #include <linux/ioport.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
+#include <linux/spinlock.h>
+#include <linux/input.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/bitops.h>
+#include <linux/slab.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+#include <linux/mutex.h>
 
 #include <asm/io.h>
 #include <asm/uaccess.h>
@@ -13,10 +26,15 @@
 #include <asm/siginfo.h>
 
 #include "efm32gg.h"
+#include "gamepad.h"
 
 static int __init gamepad_init(void);
 static void __exit gamepad_cleanup(void);
 static irqreturn_t interrupt_handler(int irq, void *dev_id);
+static enum hrtimer_restart debounce_handler(struct hrtimer *timer);
+static void gamepad_report(ktime_t edge_time);
+static int gamepad_input_register(void);
+static void gamepad_debugfs_create(void);
 static int gamepad_fasync(int fd, struct file *file, int mode);
 static int gamepad_open(struct inode *inode, struct file *file);
 static int gamepad_release(struct inode *inode, struct file *file);
@@ -24,23 +42,113 @@ static ssize_t gamepad_read(struct file *file, char __user *buffer,
     size_t size, loff_t *offset);
 static ssize_t gamepad_write(struct file *file, const char __user *buffer,
     size_t size, loff_t *offset);
+static unsigned int gamepad_poll(struct file *file, poll_table *wait);
+static long gamepad_ioctl(struct file *file, unsigned int cmd,
+    unsigned long arg);
+static enum hrtimer_restart led_handler(struct hrtimer *timer);
+static void led_set(uint32_t leds);
+static void led_stop(void);
 void destroy_device(void);
 
 #define DRIVER_NAME "gamepad"
 
+/* Number of gamepad buttons, one per GPIO_PC pin */
+#define N_PINS 8
+
+/* Pins whose flags raise IRQ 17, the odd ones raise IRQ 18 */
+#define EVEN_PINS 0x55
+
+/* Extra windows granted to a pin that is still bouncing when sampled */
+#define DEBOUNCE_MAX_RETRIES 4
+
+/* LEDs sit on PA8 - PA14 and are active low, PA15 is routed to the EBI */
+#define LED_SHIFT 8
+#define LED_MASK  (((1 << GAMEPAD_N_LEDS) - 1) << LED_SHIFT)
+
+/* Events kept for readers, must be a power of two */
+#define EVENT_RING_SIZE 64
+
+/* Latency histogram buckets, bucket n counts [2^n, 2^(n+1)) microseconds */
+#define LATENCY_BUCKETS 24
+
 struct cdev device;
 static dev_t device_number;
 struct class *device_class;
 
 struct fasync_struct *async_queue;
 
+struct gamepad_event
+{
+    ktime_t time;
+    uint8_t state;
+};
+
+/* Events shared by all readers, 'event_head' counts every event reported */
+static struct gamepad_event event_ring[EVENT_RING_SIZE];
+static uint32_t event_head;
+static DECLARE_WAIT_QUEUE_HEAD(event_wait);
+
+/* Per open file read position in 'event_ring' */
+struct gamepad_reader
+{
+    uint32_t tail;
+};
+
+/* Protects the GPIO interrupt mask and the debounce state */
+static DEFINE_SPINLOCK(gamepad_lock);
+
+static struct hrtimer debounce_timer;
+static uint32_t debounce_pins;
+static int debounce_retries;
+static ktime_t debounce_edge_time;
+
+struct gamepad_stats
+{
+    uint32_t irq_count[2];
+    uint32_t spurious;
+    uint32_t dropped;
+    uint32_t latency[LATENCY_BUCKETS];
+} stats;
+
+struct dentry *debug_dir;
+
+static unsigned int debounce_ms = 10;
+module_param(debounce_ms, uint, 0644);
+MODULE_PARM_DESC(debounce_ms, "Debounce window in milliseconds, 0 disables");
+
+static unsigned int bounce_count[N_PINS];
+module_param_array(bounce_count, uint, NULL, 0444);
+MODULE_PARM_DESC(bounce_count, "Filtered contact bounces per button");
+
+static bool evdev;
+module_param(evdev, bool, 0444);
+MODULE_PARM_DESC(evdev, "Also register the gamepad as an input device");
+
+struct input_dev *input_device;
+
+/* Key codes reported by the input device, indexed by button pin */
+static unsigned short gamepad_keymap[N_PINS] = {
+    KEY_LEFT, KEY_UP, KEY_RIGHT, KEY_DOWN, /* SW1 - SW4 */
+    BTN_X,    BTN_Y,  BTN_B,     BTN_A     /* SW5 - SW8 */
+};
+
+/* Serializes LED updates from userspace, 'led_timer' plays 'led_frames' */
+static DEFINE_MUTEX(led_mutex);
+static struct hrtimer led_timer;
+static struct gamepad_led_frame *led_frames;
+static uint32_t led_n_frames;
+static uint32_t led_frame;
+static uint32_t led_flags;
+
 static struct file_operations driver_fops = {
     .owner   = THIS_MODULE,
     .read    = gamepad_read,
     .write   = gamepad_write,
     .open    = gamepad_open,
     .release = gamepad_release,
-    .fasync  = gamepad_fasync
+    .fasync  = gamepad_fasync,
+    .poll    = gamepad_poll,
+    .unlocked_ioctl = gamepad_ioctl
 };
 
 module_init(gamepad_init);
@@ -82,17 +190,47 @@ static int __init gamepad_init(void)
         return 1;
     }
 
+    mem_region = request_mem_region(GPIO_PA_BASE, 0x24, DRIVER_NAME);
+    if (mem_region == NULL)
+    {
+        printk(KERN_ALERT "Failed to allocate memory region\n");
+        release_mem_region(GPIO_PC_DIN, 1);
+        destroy_device();
+        return 1;
+    }
+
+    /* Configure LEDs, leaving the mode of PA15 untouched */
+    iowrite32(2, GPIO_PA_CTRL);
+    iowrite32((ioread32(GPIO_PA_MODEH) & 0xf0000000) | 0x05555555,
+        GPIO_PA_MODEH);
+    led_set(0);
+
+    hrtimer_init(&led_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    led_timer.function = led_handler;
+
     /* Configure gamepad */
     iowrite32(0x33333333, GPIO_PC_MODEL);
     iowrite32(0xff, GPIO_PC_DOUT);
 
-    /* Configure interrupt generation from gamepad */
+    /* Configure interrupt generation from gamepad, on presses and releases
+       so readers see when a button is let go and can tell a second press */
     iowrite32(0xff, GPIO_IEN);
     iowrite32(0x22222222, GPIO_EXTIPSELL);
     iowrite32(0xff, GPIO_EXTIFALL);
+    iowrite32(0xff, GPIO_EXTIRISE);
     iowrite32(0xff, GPIO_IEN);
     iowrite32(0xff, GPIO_IFC);
 
+    /* Setup input device, the char device keeps working without it */
+    if (evdev && gamepad_input_register() < 0)
+        printk(KERN_ALERT "Failed to register input device\n");
+
+    gamepad_debugfs_create();
+
+    /* Configure debounce timer */
+    hrtimer_init(&debounce_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    debounce_timer.function = debounce_handler;
+
     /* Configure interrupt handling for GPIO_ODD and GPIO_EVEN */
     request_irq(17, (irq_handler_t)interrupt_handler, 0, DRIVER_NAME,
         &device);
@@ -109,9 +247,22 @@ static void __exit gamepad_cleanup(void)
     printk(KERN_INFO "Unloading gamepad driver...\n");
 
     iowrite32(0x0000, GPIO_IEN);
+    iowrite32(0x0000, GPIO_EXTIRISE);
     free_irq(17, &device);
     free_irq(18, &device);
+    hrtimer_cancel(&debounce_timer);
+
+    if (input_device)
+        input_unregister_device(input_device);
 
+    debugfs_remove_recursive(debug_dir);
+
+    led_stop();
+    kfree(led_frames);
+    led_set(0);
+    iowrite32(ioread32(GPIO_PA_MODEH) & 0xf0000000, GPIO_PA_MODEH);
+
+    release_mem_region(GPIO_PA_BASE, 0x24);
     release_mem_region(GPIO_PC_DIN, 1);
 
     destroy_device();
@@ -119,24 +270,245 @@ static void __exit gamepad_cleanup(void)
     printk(KERN_INFO "Gamepad driver unloaded!\n");
 }
 
-/* Dispatches SIGIO to list of recipients */
+/* Returns the debounce window as a relative timer expiry */
+static ktime_t debounce_interval(void)
+{
+    return ktime_set(debounce_ms / MSEC_PER_SEC,
+        (debounce_ms % MSEC_PER_SEC) * NSEC_PER_MSEC);
+}
+
+/* Masks the pins that triggered and opens a debounce window
+
+   Every pin that triggers while the window is open joins it, so a chord of
+   buttons pressed together is reported as a single event. With debouncing
+   disabled the event is reported directly.
+
+   Only the enabled pins of this line are taken. Pins masked during a
+   window keep their flags, debounce_handler() reads them as bounces.
+*/
 static irqreturn_t interrupt_handler(int irq_no, void *dev_id)
 {
-    iowrite32(0xff, GPIO_IFC);
+    unsigned long flags;
+    ktime_t now = ktime_get();
+    uint32_t line = irq_no == 17 ? EVEN_PINS : ~EVEN_PINS & 0xff;
+    uint32_t pins = ioread32(GPIO_IF) & ioread32(GPIO_IEN) & line;
+
+    stats.irq_count[irq_no == 17 ? 0 : 1]++;
+
+    if (!pins)
+    {
+        stats.spurious++;
+        return IRQ_NONE;
+    }
+
+    iowrite32(pins, GPIO_IFC);
+
+    spin_lock_irqsave(&gamepad_lock, flags);
+
+    if (debounce_ms == 0)
+    {
+        gamepad_report(now);
+    }
+    else
+    {
+        iowrite32(ioread32(GPIO_IEN) & ~pins, GPIO_IEN);
+        if (!debounce_pins)
+        {
+            debounce_retries = 0;
+            debounce_edge_time = now;
+            hrtimer_start(&debounce_timer, debounce_interval(),
+                HRTIMER_MODE_REL);
+        }
+        debounce_pins |= pins;
+    }
+
+    spin_unlock_irqrestore(&gamepad_lock, flags);
+
+    return IRQ_HANDLED;
+}
+
+/* Closes the debounce window once the masked pins have stopped bouncing
+
+   Masked pins still latch their interrupt flag, so a flag raised during the
+   window means the contact bounced. Such pins get another window, up to
+   DEBOUNCE_MAX_RETRIES, before the state is reported regardless.
+*/
+static enum hrtimer_restart debounce_handler(struct hrtimer *timer)
+{
+    unsigned long flags;
+    enum hrtimer_restart restart = HRTIMER_NORESTART;
+    uint32_t bounced;
+    int pin;
+
+    spin_lock_irqsave(&gamepad_lock, flags);
+
+    bounced = ioread32(GPIO_IF) & debounce_pins;
+    iowrite32(bounced, GPIO_IFC);
+
+    for (pin = 0; pin < N_PINS; pin++)
+        if (bounced & (1 << pin))
+            bounce_count[pin]++;
+
+    if (bounced && debounce_retries++ < DEBOUNCE_MAX_RETRIES)
+    {
+        hrtimer_forward_now(timer, debounce_interval());
+        restart = HRTIMER_RESTART;
+    }
+    else
+    {
+        iowrite32(ioread32(GPIO_IEN) | debounce_pins, GPIO_IEN);
+        debounce_pins = 0;
+        gamepad_report(debounce_edge_time);
+    }
+
+    spin_unlock_irqrestore(&gamepad_lock, flags);
+
+    return restart;
+}
+
+/* Queues the key states for readers, dispatches SIGIO to list of recipients
+   and reports the key states to the input device
+
+   Each event is stored once in 'event_ring' and every reader consumes it
+   through its own tail. The input core timestamps the batch and drops keys
+   that did not change, so every key is reported followed by a single
+   SYN_REPORT. The pins are read once so readers and the input device see
+   the same state.
+*/
+static void gamepad_report(ktime_t edge_time)
+{
+    struct gamepad_event *event = &event_ring[event_head % EVENT_RING_SIZE];
+    uint32_t state = ioread32(GPIO_PC_DIN);
+    uint32_t pressed = ~state;
+    int pin;
+
+    event->time = edge_time;
+    event->state = state;
+    event_head++;
+
+    wake_up_interruptible(&event_wait);
 
     if (async_queue)
         kill_fasync(&async_queue, SIGIO, POLL_IN);
 
-    return IRQ_HANDLED;
+    if (input_device)
+    {
+        for (pin = 0; pin < N_PINS; pin++)
+            input_report_key(input_device, gamepad_keymap[pin],
+                pressed & (1 << pin));
+        input_sync(input_device);
+    }
+}
+
+/* Registers the gamepad with the input subsystem */
+static int gamepad_input_register(void)
+{
+    int status = 0;
+    int pin;
+
+    input_device = input_allocate_device();
+    if (input_device == NULL)
+        return -ENOMEM;
+
+    input_device->name = "EFM32GG gamepad";
+    input_device->phys = DRIVER_NAME "/input0";
+    input_device->id.bustype = BUS_HOST;
+
+    input_device->keycode = gamepad_keymap;
+    input_device->keycodesize = sizeof(gamepad_keymap[0]);
+    input_device->keycodemax = N_PINS;
+
+    __set_bit(EV_KEY, input_device->evbit);
+    for (pin = 0; pin < N_PINS; pin++)
+        __set_bit(gamepad_keymap[pin], input_device->keybit);
+
+    status = input_register_device(input_device);
+    if (status < 0)
+    {
+        input_free_device(input_device);
+        input_device = NULL;
+    }
+
+    return status;
+}
+
+/* Adds the delay from button edge to consumption to the histogram */
+static void latency_record(ktime_t latency)
+{
+    s64 us = ktime_to_us(latency);
+    int bucket = us > 1 ? fls64(us) - 1 : 0;
+
+    if (bucket >= LATENCY_BUCKETS)
+        bucket = LATENCY_BUCKETS - 1;
+
+    stats.latency[bucket]++;
 }
 
-/* Copies the first 'size' bytes from GPIO_PC_DIN to 'buffer' */
+/* Copies up to 'size' unread events to 'buffer'
+
+   Each event is one GPIO_PC_DIN byte. Blocks until an event is available
+   unless the file is non-blocking. A reader that fell more than
+   EVENT_RING_SIZE events behind skips the overwritten ones, which count as
+   dropped.
+*/
 static ssize_t gamepad_read(struct file *file, char __user *buffer,
     size_t size, loff_t *offset)
 {
-    int8_t data = ioread32(GPIO_PC_DIN);
-    copy_to_user(buffer, &data, size);
-    return 0;
+    struct gamepad_reader *reader = file->private_data;
+    struct gamepad_event *event;
+    uint8_t data[EVENT_RING_SIZE];
+    unsigned long flags;
+    ktime_t now;
+    size_t n = 0;
+
+    if (size == 0)
+        return 0;
+
+    if (file->f_flags & O_NONBLOCK)
+    {
+        if (event_head == reader->tail)
+            return -EAGAIN;
+    }
+    else if (wait_event_interruptible(event_wait, event_head != reader->tail))
+    {
+        return -ERESTARTSYS;
+    }
+
+    spin_lock_irqsave(&gamepad_lock, flags);
+
+    if (event_head - reader->tail > EVENT_RING_SIZE)
+    {
+        stats.dropped += event_head - reader->tail - EVENT_RING_SIZE;
+        reader->tail = event_head - EVENT_RING_SIZE;
+    }
+
+    now = ktime_get();
+    while (reader->tail != event_head && n < size)
+    {
+        event = &event_ring[reader->tail++ % EVENT_RING_SIZE];
+        latency_record(ktime_sub(now, event->time));
+        data[n++] = event->state;
+    }
+
+    spin_unlock_irqrestore(&gamepad_lock, flags);
+
+    if (copy_to_user(buffer, data, n))
+        return -EFAULT;
+
+    return n;
+}
+
+/* Reports the file readable while it has unread events, always writable */
+static unsigned int gamepad_poll(struct file *file, poll_table *wait)
+{
+    struct gamepad_reader *reader = file->private_data;
+
+    poll_wait(file, &event_wait, wait);
+
+    if (event_head != reader->tail)
+        return POLLIN | POLLRDNORM | POLLOUT | POLLWRNORM;
+
+    return POLLOUT | POLLWRNORM;
 }
 
 /* Registers the calling process to list of SIGIO recipients */
@@ -145,19 +517,169 @@ static int gamepad_fasync(int fd, struct file *file, int mode)
     return fasync_helper(fd, file, mode, &async_queue);
 }
 
+/* Lights the LEDs given by the last byte of 'buffer'
+
+   Stops any sequence started through GAMEPAD_IOC_LED_PLAY.
+*/
 static ssize_t gamepad_write(struct file *file, const char __user *buffer,
     size_t size, loff_t *offset)
 {
+    uint8_t leds;
+
+    if (size == 0)
+        return 0;
+
+    if (copy_from_user(&leds, buffer + size - 1, 1))
+        return -EFAULT;
+
+    mutex_lock(&led_mutex);
+    led_stop();
+    led_set(leds);
+    mutex_unlock(&led_mutex);
+
+    return size;
+}
+
+/* Starts playing a sequence of LED frames on the hrtimer
+
+   Frames shorter than GAMEPAD_LED_MIN_US are rejected, the timer would
+   otherwise keep the CPU in interrupt context.
+*/
+static long led_play(const struct gamepad_led_sequence *sequence)
+{
+    struct gamepad_led_frame *frames;
+    struct gamepad_led_frame *old_frames;
+    size_t size;
+    u32 i;
+
+    if (sequence->n_frames == 0 ||
+        sequence->n_frames > GAMEPAD_LED_MAX_FRAMES)
+        return -EINVAL;
+
+    size = sequence->n_frames * sizeof(*frames);
+    frames = kmalloc(size, GFP_KERNEL);
+    if (frames == NULL)
+        return -ENOMEM;
+
+    if (copy_from_user(frames,
+        (const void __user *)(uintptr_t)sequence->frames, size))
+    {
+        kfree(frames);
+        return -EFAULT;
+    }
+
+    for (i = 0; i < sequence->n_frames; i++)
+    {
+        if (frames[i].duration_us < GAMEPAD_LED_MIN_US)
+        {
+            kfree(frames);
+            return -EINVAL;
+        }
+    }
+
+    mutex_lock(&led_mutex);
+
+    led_stop();
+    old_frames = led_frames;
+    led_frames = frames;
+    led_n_frames = sequence->n_frames;
+    led_flags = sequence->flags;
+    led_frame = 0;
+
+    led_set(frames[0].leds);
+    hrtimer_start(&led_timer, ns_to_ktime(
+        (u64)frames[0].duration_us * NSEC_PER_USEC), HRTIMER_MODE_REL);
+
+    mutex_unlock(&led_mutex);
+
+    kfree(old_frames);
+
     return 0;
 }
 
+static long gamepad_ioctl(struct file *file, unsigned int cmd,
+    unsigned long arg)
+{
+    struct gamepad_led_sequence sequence;
+
+    switch (cmd)
+    {
+    case GAMEPAD_IOC_LED_PLAY:
+        if (copy_from_user(&sequence, (const void __user *)arg,
+            sizeof(sequence)))
+            return -EFAULT;
+        return led_play(&sequence);
+    case GAMEPAD_IOC_LED_STOP:
+        mutex_lock(&led_mutex);
+        led_stop();
+        mutex_unlock(&led_mutex);
+        return 0;
+    }
+
+    return -ENOTTY;
+}
+
+/* Advances to the next frame, scheduled relative to the previous expiry so
+   the sequence does not drift
+
+   An expiry that comes late past the whole frame is moved forward to the
+   next frame boundary after now, rather than replaying the missed ones.
+*/
+static enum hrtimer_restart led_handler(struct hrtimer *timer)
+{
+    if (++led_frame >= led_n_frames)
+    {
+        if (!(led_flags & GAMEPAD_LED_REPEAT))
+            return HRTIMER_NORESTART;
+        led_frame = 0;
+    }
+
+    led_set(led_frames[led_frame].leds);
+    hrtimer_forward_now(timer, ns_to_ktime(
+        (u64)led_frames[led_frame].duration_us * NSEC_PER_USEC));
+
+    return HRTIMER_RESTART;
+}
+
+/* Stops the LED sequence, the caller holds 'led_mutex' */
+static void led_stop(void)
+{
+    hrtimer_cancel(&led_timer);
+}
+
+/* Lights the LEDs set in 'leds' through DOUTCLR/DOUTSET, without a
+   read-modify-write of GPIO_PA_DOUT */
+static void led_set(uint32_t leds)
+{
+    uint32_t on = (leds << LED_SHIFT) & LED_MASK;
+
+    iowrite32(on, GPIO_PA_DOUTCLR);
+    iowrite32(~on & LED_MASK, GPIO_PA_DOUTSET);
+}
+
+/* Gives the file its own read position, starting at the next event */
 static int gamepad_open(struct inode *inode, struct file *file)
 {
+    struct gamepad_reader *reader;
+    unsigned long flags;
+
+    reader = kzalloc(sizeof(*reader), GFP_KERNEL);
+    if (reader == NULL)
+        return -ENOMEM;
+
+    spin_lock_irqsave(&gamepad_lock, flags);
+    reader->tail = event_head;
+    spin_unlock_irqrestore(&gamepad_lock, flags);
+
+    file->private_data = reader;
+
     return 0;
 }
 
 static int gamepad_release(struct inode *inode, struct file *file)
 {
+    gamepad_fasync(-1, file, 0);
+    kfree(file->private_data);
     return 0;
 }
 
@@ -168,3 +690,71 @@ void destroy_device(void)
     cdev_del(&device);
     unregister_chrdev_region(device_number, 1);
 }
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Debugfs statistics
+ *
+ *----------------------------------------------------------------------------*/
+
+
+/* Prints one line per latency bucket as '<lower bound in us> <count>' */
+static int latency_show(struct seq_file *m, void *v)
+{
+    int i;
+
+    for (i = 0; i < LATENCY_BUCKETS; i++)
+        seq_printf(m, "%10lu %u\n", i ? 1UL << i : 0UL, stats.latency[i]);
+
+    return 0;
+}
+
+static int latency_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, latency_show, NULL);
+}
+
+/* Clears all statistics on any write */
+static ssize_t reset_write(struct file *file, const char __user *buffer,
+    size_t size, loff_t *offset)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&gamepad_lock, flags);
+    memset(&stats, 0, sizeof(stats));
+    spin_unlock_irqrestore(&gamepad_lock, flags);
+
+    return size;
+}
+
+static const struct file_operations latency_fops = {
+    .owner   = THIS_MODULE,
+    .open    = latency_open,
+    .read    = seq_read,
+    .llseek  = seq_lseek,
+    .release = single_release
+};
+
+static const struct file_operations reset_fops = {
+    .owner = THIS_MODULE,
+    .write = reset_write
+};
+
+/* Exposes the statistics under /sys/kernel/debug/gamepad/ */
+static void gamepad_debugfs_create(void)
+{
+    debug_dir = debugfs_create_dir(DRIVER_NAME, NULL);
+    if (IS_ERR_OR_NULL(debug_dir))
+    {
+        debug_dir = NULL;
+        return;
+    }
+
+    debugfs_create_u32("irq17", 0444, debug_dir, &stats.irq_count[0]);
+    debugfs_create_u32("irq18", 0444, debug_dir, &stats.irq_count[1]);
+    debugfs_create_u32("spurious", 0444, debug_dir, &stats.spurious);
+    debugfs_create_u32("dropped", 0444, debug_dir, &stats.dropped);
+    debugfs_create_file("latency", 0444, debug_dir, NULL, &latency_fops);
+    debugfs_create_file("reset", 0200, debug_dir, NULL, &reset_fops);
+}
@@ -0,0 +1,41 @@
+#ifndef GAMEPAD_H
+#define GAMEPAD_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/* Number of LEDs driven through /dev/gamepad, bit n of a bitmap is LED n */
+#define GAMEPAD_N_LEDS 7
+
+/* Longest animation accepted by GAMEPAD_IOC_LED_PLAY */
+#define GAMEPAD_LED_MAX_FRAMES 256
+
+/* Shortest frame accepted by GAMEPAD_IOC_LED_PLAY */
+#define GAMEPAD_LED_MIN_US 1000
+
+/* Restart the animation after its last frame */
+#define GAMEPAD_LED_REPEAT (1 << 0)
+
+struct gamepad_led_frame
+{
+    __u32 leds;
+    __u32 duration_us;
+};
+
+struct gamepad_led_sequence
+{
+    __u64 frames;   /* User pointer to 'n_frames' struct gamepad_led_frame */
+    __u32 n_frames;
+    __u32 flags;
+};
+
+#define GAMEPAD_IOC_MAGIC 'g'
+
+/* Plays a sequence of LED frames, replacing the one currently playing */
+#define GAMEPAD_IOC_LED_PLAY \
+    _IOW(GAMEPAD_IOC_MAGIC, 1, struct gamepad_led_sequence)
+
+/* Stops the current sequence, leaving its last frame lit */
+#define GAMEPAD_IOC_LED_STOP _IO(GAMEPAD_IOC_MAGIC, 2)
+
+#endif /* GAMEPAD_H */
@@ -0,0 +1,264 @@
+#include <stdlib.h>
+
+#include "autopilot.h"
+
+/* Number of movement directions */
+#define N_DIRECTIONS 4
+
+/* Breadth first search from 'start' to 'target' around the 'length' cells
+   of 'cells', given tail first
+
+   A body cell counts as free from the move its segment leaves it on, so
+   the search can follow the tail. Returns the number of moves to 'target',
+   or -1 if it cannot be reached.
+*/
+static int search(Autopilot *pilot, const Snake *snake, const cell_t *cells,
+    int length, cell_t start, cell_t target)
+{
+    uint32_t *seen = pilot->seen;
+    uint32_t *depth = pilot->depth;
+    uint32_t *vacated = pilot->vacated;
+    cell_t *queue = pilot->queue;
+    int head = 0;
+    int tail = 0;
+    int found = -1;
+    cell_t cell;
+    cell_t next;
+    uint32_t generation;
+    int d;
+
+    for (int k = 0; k < length; k++)
+        vacated[cells[k]] = k + 1;
+
+    generation = ++pilot->generation;
+    seen[start] = generation;
+    depth[start] = 0;
+    queue[tail++] = start;
+
+    while (head < tail && found < 0)
+    {
+        cell = queue[head++];
+        d = depth[cell] + 1;
+
+        for (int dir = 0; dir < N_DIRECTIONS; dir++)
+        {
+            next = cell_step(snake, cell, dir);
+            if (seen[next] == generation || d < vacated[next])
+                continue;
+
+            seen[next] = generation;
+            depth[next] = d;
+            pilot->parent[next] = cell;
+            if (next == target)
+            {
+                found = d;
+                break;
+            }
+            queue[tail++] = next;
+        }
+    }
+
+    for (int k = 0; k < length; k++)
+        vacated[cells[k]] = 0;
+
+    return found;
+}
+
+/* Returns the direction from 'cell' to its neighbour 'next' */
+static int direction_to(const Snake *snake, cell_t cell, cell_t next)
+{
+    for (int dir = 0; dir < N_DIRECTIONS; dir++)
+        if (cell_step(snake, cell, dir) == next)
+            return dir;
+
+    return RIGHT;
+}
+
+/* Returns 1 if the head can move onto 'cell' on the next tick */
+static int can_enter(const Snake *snake, cell_t cell)
+{
+    return !snake_collision(snake, cell) || cell == snake_tail(snake);
+}
+
+/* Lays out the Hamiltonian cycle used when no safe path to the apple exists
+
+   The cycle runs right along the top row, snakes through the other rows
+   leaving out the leftmost column and returns up that column, which needs
+   an even number of rows. With an odd number the last row is left out of
+   that and spliced in from the right end of the row above, running right
+   through the wrap around the board's edge and back up one column left.
+*/
+static void init_cycle(Autopilot *pilot, int width, int height)
+{
+    cell_t *path = pilot->queue;
+    int rows = height - height % 2;
+    int n = 0;
+
+    for (int x = 0; x < width; x++)
+        path[n++] = (cell_t)x;
+    for (int y = 1; y < rows; y++)
+    {
+        if (y % 2)
+        {
+            for (int x = width - 1; x > 0; x--)
+            {
+                path[n++] = (cell_t)y * width + x;
+                if (y == rows - 1 && rows < height && x == width - 1)
+                    for (int i = 0; i < width; i++)
+                        path[n++] = (cell_t)rows * width +
+                            (width - 1 + i) % width;
+            }
+        }
+        else
+            for (int x = 1; x < width; x++)
+                path[n++] = (cell_t)y * width + x;
+    }
+    for (int y = rows - 1; y > 0; y--)
+        path[n++] = (cell_t)y * width;
+
+    for (int i = 0; i < n; i++)
+        pilot->cycle_next[path[i]] = path[(i + 1) % n];
+}
+
+/* Allocates the search state for a 'width' x 'height' board
+
+   Returns 1 if memory ran out.
+*/
+int autopilot_create(Autopilot *pilot, int width, int height)
+{
+    int n = width * height;
+
+    pilot->n_cells = n;
+    pilot->generation = 0;
+    pilot->cycle_next = malloc(n * sizeof(cell_t));
+    pilot->seen = calloc(n, sizeof(uint32_t));
+    pilot->depth = malloc(n * sizeof(uint32_t));
+    pilot->parent = malloc(n * sizeof(cell_t));
+    pilot->queue = malloc(n * sizeof(cell_t));
+    pilot->vacated = calloc(n, sizeof(uint32_t));
+    pilot->body = malloc(2 * n * sizeof(cell_t));
+
+    if (!pilot->cycle_next || !pilot->seen ||
+        !pilot->depth || !pilot->parent || !pilot->queue || !pilot->vacated ||
+        !pilot->body)
+    {
+        autopilot_destroy(pilot);
+        return 1;
+    }
+
+    init_cycle(pilot, width, height);
+
+    return 0;
+}
+
+void autopilot_destroy(Autopilot *pilot)
+{
+    free(pilot->cycle_next);
+    free(pilot->seen);
+    free(pilot->depth);
+    free(pilot->parent);
+    free(pilot->queue);
+    free(pilot->vacated);
+    free(pilot->body);
+}
+
+/* Allocates an empty plan for a game on a 'width' x 'height' board
+
+   Returns 1 if memory ran out.
+*/
+int autopilot_plan_create(Plan *plan, int width, int height)
+{
+    plan->step = 0;
+    plan->path = malloc(width * height * sizeof(cell_t));
+
+    return plan->path == NULL;
+}
+
+void autopilot_plan_destroy(Plan *plan)
+{
+    free(plan->path);
+}
+
+/* Returns 1 if 'snake' is still on the path planned to 'apple'
+
+   The path was safe when found and the board changes along it exactly as
+   the search assumed, so it stays safe while the snake keeps to it.
+*/
+static int on_plan(const Plan *plan, const Snake *snake, cell_t apple)
+{
+    int step = plan->step;
+
+    return step > 0 && plan->apple == apple &&
+        plan->length == snake->length && step < plan->moves &&
+        plan->path[step - 1] == snake_head(snake) &&
+        can_enter(snake, plan->path[step]);
+}
+
+/* Picks the direction for the next tick of 'snake' heading in 'direction',
+   'pilot' holds the search state and may be shared by games played in turn,
+   'plan' is the game's own
+
+   The shortest path to 'apple' is taken if the snake can still reach its
+   tail after eating. Otherwise the snake follows the Hamiltonian cycle,
+   then chases its tail, then takes any free cell.
+*/
+int autopilot_direction(Autopilot *pilot, Plan *plan, const Snake *snake,
+    cell_t apple, int direction)
+{
+    cell_t *body = pilot->body;
+    cell_t *path = plan->path;
+    cell_t *parent = pilot->parent;
+    cell_t head = snake_head(snake);
+    int length = snake->length;
+    int moves;
+    cell_t cell;
+
+    if (on_plan(plan, snake, apple))
+    {
+        cell = path[plan->step++];
+        return direction_to(snake, head, cell);
+    }
+    plan->step = 0;
+
+    for (int k = 0; k < length; k++)
+        body[k] = snake_segment(snake, length - 1 - k);
+
+    moves = search(pilot, snake, body, length, head, apple);
+    if (moves > 0)
+    {
+        cell = apple;
+        for (int i = moves - 1; i >= 0; i--, cell = parent[cell])
+            path[i] = cell;
+        for (int i = 0; i < moves; i++)
+            body[length + i] = path[i];
+
+        /* After eating the body is the last 'length + 1' of these cells */
+        if (length + 1 == snake->n_cells ||
+            search(pilot, snake, body + moves - 1, length + 1, apple,
+                body[moves - 1]) > 0)
+        {
+            plan->apple = apple;
+            plan->length = length;
+            plan->moves = moves;
+            plan->step = 1;
+            return direction_to(snake, head, path[0]);
+        }
+    }
+
+    if (can_enter(snake, pilot->cycle_next[head]))
+        return direction_to(snake, head, pilot->cycle_next[head]);
+
+    moves = search(pilot, snake, body, length, head, body[0]);
+    if (moves > 0)
+    {
+        for (cell = body[0]; parent[cell] != head; cell = parent[cell])
+            ;
+        return direction_to(snake, head, cell);
+    }
+
+    for (int dir = 0; dir < N_DIRECTIONS; dir++)
+        if (can_enter(snake, cell_step(snake, head, dir)))
+            return dir;
+
+    return direction;
+}
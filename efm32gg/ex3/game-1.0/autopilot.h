@@ -0,0 +1,53 @@
+#ifndef AUTOPILOT_H
+#define AUTOPILOT_H
+
+#include "snake.h"
+
+typedef struct Autopilot Autopilot;
+typedef struct Plan Plan;
+
+/* Path search state for one board size, one per thread playing */
+struct Autopilot
+{
+    int n_cells;
+
+    /* Cell following each cell on a Hamiltonian cycle of the board */
+    cell_t *cycle_next;
+
+    /* Cells are in the current search when 'seen' equals 'generation' */
+    uint32_t *seen;
+    uint32_t generation;
+    uint32_t *depth;
+    cell_t *parent;
+    cell_t *queue;
+
+    /* Moves until a body cell is vacated, 0 for cells not covered */
+    uint32_t *vacated;
+
+    /* Body cells tail first, followed by the path to the apple */
+    cell_t *body;
+};
+
+/* Path to 'apple' last found safe for one game at 'length', followed until a
+   move leaves it so the board is not searched again every tick
+
+   One per game rather than per pilot, so the moves of a game do not depend
+   on which other games its pilot served in between.
+*/
+struct Plan
+{
+    cell_t *path;
+    cell_t apple;
+    int length;
+    int moves;
+    int step;       /* Next cell of 'path', 0 when there is no plan */
+};
+
+int autopilot_create(Autopilot *pilot, int width, int height);
+void autopilot_destroy(Autopilot *pilot);
+int autopilot_plan_create(Plan *plan, int width, int height);
+void autopilot_plan_destroy(Plan *plan);
+int autopilot_direction(Autopilot *pilot, Plan *plan, const Snake *snake,
+    cell_t apple, int direction);
+
+#endif /* AUTOPILOT_H */
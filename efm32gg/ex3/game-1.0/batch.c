@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "batch.h"
+#include "engine.h"
+#include "rng.h"
+
+/* Steps games [chunk * BATCH_CHUNK, (chunk + 1) * BATCH_CHUNK) */
+static void batch_task(void *arg, int chunk, int worker)
+{
+    Batch *batch = arg;
+    Autopilot *pilot = &batch->pilots[worker];
+    int first = chunk * BATCH_CHUNK;
+    int last = first + BATCH_CHUNK;
+    cell_t vacated;
+    int result;
+
+    if (last > batch->n_games)
+        last = batch->n_games;
+
+    for (int g = first; g < last; g++)
+    {
+        Snake *snake = &batch->snakes[g];
+
+        for (int i = 0; i < batch->steps; i++)
+        {
+            batch->directions[g] = autopilot_direction(pilot,
+                &batch->plans[g], snake, batch->apples[g],
+                batch->directions[g]);
+            result = engine_step(snake, &batch->apples[g], &batch->rngs[g],
+                batch->directions[g], &vacated);
+
+            if (result == ENGINE_DIED || result == ENGINE_FULL)
+            {
+                batch->games[g]++;
+                batch->scores[g] += snake->length;
+                engine_reset(snake, &batch->apples[g], &batch->rngs[g]);
+                batch->directions[g] = RIGHT;
+                batch->plans[g].step = 0;
+            }
+        }
+    }
+}
+
+/* Starts 'n_games' games on 'width' x 'height' boards for a pool of
+   'n_workers', game 'i' is seeded from 'seed' and 'i' so runs are
+   reproducible whatever the number of workers */
+int batch_init(Batch *batch, int n_games, int width, int height,
+    int n_workers, uint32_t seed)
+{
+    batch->n_games = n_games;
+    batch->n_workers = n_workers;
+    batch->snakes = calloc(n_games, sizeof(Snake));
+    batch->apples = malloc(n_games * sizeof(cell_t));
+    batch->directions = malloc(n_games);
+    batch->rngs = malloc(n_games * sizeof(uint32_t));
+    batch->plans = calloc(n_games, sizeof(Plan));
+    batch->games = calloc(n_games, sizeof(uint32_t));
+    batch->scores = calloc(n_games, sizeof(uint32_t));
+    batch->pilots = calloc(n_workers, sizeof(Autopilot));
+
+    if (!batch->snakes || !batch->apples || !batch->directions ||
+        !batch->rngs || !batch->plans || !batch->games || !batch->scores ||
+        !batch->pilots)
+    {
+        printf("Failed to allocate batch\n");
+        batch_free(batch);
+        return 1;
+    }
+
+    for (int i = 0; i < n_workers; i++)
+    {
+        if (autopilot_create(&batch->pilots[i], width, height))
+        {
+            printf("Failed to allocate autopilot\n");
+            batch_free(batch);
+            return 1;
+        }
+    }
+
+    for (int g = 0; g < n_games; g++)
+    {
+        if (snake_create(&batch->snakes[g], width, height) ||
+            autopilot_plan_create(&batch->plans[g], width, height))
+        {
+            printf("Failed to allocate board\n");
+            batch_free(batch);
+            return 1;
+        }
+        batch->rngs[g] = rng_seed(seed ^ (g * 2654435761U));
+        batch->directions[g] = RIGHT;
+        engine_reset(&batch->snakes[g], &batch->apples[g], &batch->rngs[g]);
+    }
+
+    return 0;
+}
+
+/* Advances every game by 'steps' ticks across 'pool' */
+void batch_run(Batch *batch, Pool *pool, int steps)
+{
+    batch->steps = steps;
+    pool_run(pool, batch_task, batch,
+        (batch->n_games + BATCH_CHUNK - 1) / BATCH_CHUNK);
+}
+
+/* Sums the games finished and their final lengths over the batch */
+void batch_totals(const Batch *batch, long *games, long *score)
+{
+    *games = 0;
+    *score = 0;
+
+    for (int g = 0; g < batch->n_games; g++)
+    {
+        *games += batch->games[g];
+        *score += batch->scores[g];
+    }
+}
+
+void batch_free(Batch *batch)
+{
+    for (int g = 0; batch->snakes && g < batch->n_games; g++)
+        snake_destroy(&batch->snakes[g]);
+    for (int g = 0; batch->plans && g < batch->n_games; g++)
+        autopilot_plan_destroy(&batch->plans[g]);
+    for (int i = 0; batch->pilots && i < batch->n_workers; i++)
+        autopilot_destroy(&batch->pilots[i]);
+
+    free(batch->snakes);
+    free(batch->apples);
+    free(batch->directions);
+    free(batch->rngs);
+    free(batch->plans);
+    free(batch->games);
+    free(batch->scores);
+    free(batch->pilots);
+}
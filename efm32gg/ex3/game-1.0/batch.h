@@ -0,0 +1,40 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "snake.h"
+#include "autopilot.h"
+#include "pool.h"
+
+/* Games stepped per chunk of pool work */
+#define BATCH_CHUNK 8
+
+typedef struct Batch Batch;
+
+/* Independent games played by the autopilot, each field of the game state
+   in an array of its own indexed by game */
+struct Batch
+{
+    int n_games;
+    Snake *snakes;
+    cell_t *apples;
+    uint8_t *directions;
+    uint32_t *rngs;
+    Plan *plans;
+
+    /* Games finished and the sum of their final lengths */
+    uint32_t *games;
+    uint32_t *scores;
+
+    /* Search state per pool worker */
+    Autopilot *pilots;
+    int n_workers;
+    int steps;
+};
+
+int batch_init(Batch *batch, int n_games, int width, int height,
+    int n_workers, uint32_t seed);
+void batch_run(Batch *batch, Pool *pool, int steps);
+void batch_totals(const Batch *batch, long *games, long *score);
+void batch_free(Batch *batch);
+
+#endif /* BATCH_H */
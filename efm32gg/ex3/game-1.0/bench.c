@@ -0,0 +1,496 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 1
+#define _GNU_SOURCE 1
+#endif /* _POSIX_C_SOURCE */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+
+#include "snake.h"
+#include "blit.h"
+#include "batch.h"
+#include "synth.h"
+
+/* Iterations per measurement */
+#define N_TICKS 1000000
+#define N_BLITS 100000
+
+/* Size of the surface the blitter draws into */
+#define SCREEN_W 320
+#define SCREEN_H 240
+
+#define SPRITE_SIZE 16
+#define COLOR_KEY 0xf81f
+
+/* Output rate, seconds of sound and samples per call in the synth
+   benchmark */
+#define SYNTH_RATE 44100
+#define SYNTH_SECONDS 60
+#define SYNTH_PERIOD 256
+
+/* Autopilot games and ticks per game in the batch benchmark */
+#define N_GAMES 256
+#define N_STEPS 10000
+
+/* Games and ticks per game played on each board with an odd side, long
+   enough for every size checked to finish games */
+#define N_ODD_GAMES 16
+#define N_ODD_STEPS 20000
+
+double walltime(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1.0e-9;
+}
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Snake movement
+ *
+ *----------------------------------------------------------------------------*/
+
+
+/* Body layout replaced by the ring buffer, kept as a reference point */
+struct
+{
+    int x[N_SQUARES + 1];
+    int y[N_SQUARES + 1];
+    int length;
+} shift_snake;
+
+Snake snake;
+
+void shift_move(void)
+{
+    int x_prev[shift_snake.length];
+    int y_prev[shift_snake.length];
+
+    memcpy(x_prev, shift_snake.x, shift_snake.length * sizeof(int));
+    memcpy(y_prev, shift_snake.y, shift_snake.length * sizeof(int));
+
+    for (int i = 1; i < shift_snake.length; i++)
+    {
+        shift_snake.x[i] = x_prev[i - 1];
+        shift_snake.y[i] = y_prev[i - 1];
+    }
+    shift_snake.x[0] = (shift_snake.x[0] + 1) % N_SQUARES_X;
+}
+
+/* Returns nanoseconds per move of the shifting body of 'length' segments */
+double bench_shift(int length)
+{
+    double start;
+
+    memset(&shift_snake, 0, sizeof(shift_snake));
+    shift_snake.length = length;
+
+    start = walltime();
+    for (int i = 0; i < N_TICKS; i++)
+        shift_move();
+
+    return (walltime() - start) * 1.0e9 / N_TICKS;
+}
+
+/* Returns nanoseconds per move of the ring buffer body of 'length'
+   segments */
+double bench_ring(int length)
+{
+    cell_t cell = 0;
+    double start;
+
+    snake_init(&snake, 0, 0, 1);
+    while (snake.length < length)
+        snake_push(&snake, ++cell % N_SQUARES);
+
+    start = walltime();
+    for (int i = 0; i < N_TICKS; i++)
+    {
+        snake_pop(&snake);
+        if (!snake_collision(&snake, ++cell % N_SQUARES))
+            snake_push(&snake, cell % N_SQUARES);
+    }
+
+    return (walltime() - start) * 1.0e9 / N_TICKS;
+}
+
+/* Returns nanoseconds per apple placed by drawing random cells until one
+   is free, with 'n_free' free cells left on the board */
+double bench_rejection(int n_free)
+{
+    volatile cell_t apple;
+    cell_t cell;
+    double start;
+
+    snake_init(&snake, 0, 0, 1);
+    for (cell = 1; snake.n_free > n_free; cell++)
+        snake_push(&snake, cell);
+
+    start = walltime();
+    for (int i = 0; i < N_TICKS; i++)
+    {
+        do
+            cell = rand() % N_SQUARES;
+        while (snake_collision(&snake, cell));
+        apple = cell;
+    }
+    (void)apple;
+
+    return (walltime() - start) * 1.0e9 / N_TICKS;
+}
+
+/* Returns nanoseconds per apple placed from the free cell set, with
+   'n_free' free cells left on the board */
+double bench_free_set(int n_free)
+{
+    volatile cell_t apple;
+    cell_t cell;
+    double start;
+
+    snake_init(&snake, 0, 0, 1);
+    for (cell = 1; snake.n_free > n_free; cell++)
+        snake_push(&snake, cell);
+
+    start = walltime();
+    for (int i = 0; i < N_TICKS; i++)
+        apple = snake_free_cell(&snake, rand());
+    (void)apple;
+
+    return (walltime() - start) * 1.0e9 / N_TICKS;
+}
+
+void bench_apple(void)
+{
+    int free[] = { N_SQUARES / 2, 64, 8, 1 };
+
+    printf("%-8s %12s %12s\n", "free", "reject ns", "set ns");
+    for (int i = 0; i < sizeof(free) / sizeof(free[0]); i++)
+        printf("%-8d %12.1f %12.1f\n", free[i],
+            bench_rejection(free[i]), bench_free_set(free[i]));
+}
+
+void bench_snake(void)
+{
+    int lengths[] = { 4, 16, 64, 256, N_SQUARES };
+
+    printf("%-8s %12s %12s\n", "length", "shift ns", "ring ns");
+    for (int i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+        printf("%-8d %12.1f %12.1f\n", lengths[i],
+            bench_shift(lengths[i]), bench_ring(lengths[i]));
+}
+
+/*------------------------------------------------------------------------------
+ *
+ * Blitter
+ *
+ *----------------------------------------------------------------------------*/
+
+
+uint32_t screen_pixels[SCREEN_W * SCREEN_H];
+Surface screen;
+
+uint32_t sprite_pixels[SPRITE_SIZE * SPRITE_SIZE];
+Sprite sprite = { sprite_pixels, SPRITE_SIZE, SPRITE_SIZE, COLOR_KEY };
+
+Run rle_runs[SPRITE_SIZE * SPRITE_SIZE];
+RleSprite rle_sprite = { rle_runs, 0, SPRITE_SIZE, SPRITE_SIZE, COLOR_KEY };
+
+/* Sets up 'screen' and the sprites for 'bits_per_pixel', the sprite being a
+   filled circle on a transparent background */
+void init_blit(int bits_per_pixel)
+{
+    int r = SPRITE_SIZE / 2;
+    pixel_t color;
+
+    surface_init(&screen, screen_pixels, SCREEN_W, SCREEN_H,
+        SCREEN_W * bits_per_pixel / 8, bits_per_pixel);
+
+    for (int j = 0; j < SPRITE_SIZE; j++)
+    {
+        for (int i = 0; i < SPRITE_SIZE; i++)
+        {
+            color = (i - r) * (i - r) + (j - r) * (j - r) < r * r ?
+                0x4208 : COLOR_KEY;
+            if (bits_per_pixel == 16)
+                ((uint16_t*)sprite_pixels)[j * SPRITE_SIZE + i] = color;
+            else
+                sprite_pixels[j * SPRITE_SIZE + i] = color;
+        }
+    }
+
+    rle_sprite.n_runs = rle_encode(&screen, &sprite, rle_runs,
+        SPRITE_SIZE * SPRITE_SIZE);
+}
+
+/* Square fill as it was done before the blitter, column by column */
+void column_fill(int x, int y, int size, uint16_t color)
+{
+    uint16_t *pixels = (uint16_t*)screen_pixels;
+
+    for (int i = x; i < x + size; i++)
+        for (int j = y; j < y + size; j++)
+            pixels[SCREEN_W * j + i] = color;
+}
+
+/* Prints the rate of 'n_blits' calls of 'statement' drawing 'area' pixels
+   each, at positions (x, y) spread over the screen */
+#define BENCH_BLIT(name, n_blits, area, statement)                           \
+    do                                                                       \
+    {                                                                        \
+        double start = walltime();                                           \
+        for (int i = 0; i < (n_blits); i++)                                  \
+        {                                                                    \
+            int x = (i * 37) % (SCREEN_W - SPRITE_SIZE);                     \
+            int y = (i * 17) % (SCREEN_H - SPRITE_SIZE);                     \
+            (void)x;                                                         \
+            (void)y;                                                         \
+            statement;                                                       \
+        }                                                                    \
+        printf("%-16s %12.1f\n", name, (double)(n_blits) * (area) /        \
+            (walltime() - start) * 1.0e-6);                                  \
+    }                                                                        \
+    while (0)
+
+void bench_blit(int bits_per_pixel)
+{
+    init_blit(bits_per_pixel);
+
+    printf("%-16s %12s %dbpp\n", "primitive", "Mpixels/s", bits_per_pixel);
+    if (bits_per_pixel == 16)
+        BENCH_BLIT("column 10x10", N_BLITS, 100,
+            column_fill(x, y, 10, 0x1234));
+    BENCH_BLIT("fill 10x10", N_BLITS, 100,
+        blit_fill(&screen, x, y, 10, 10, 0x1234));
+    BENCH_BLIT("fill 100x100", N_BLITS / 10, 100 * 100,
+        blit_fill(&screen, x / 4, y / 2, 100, 100, 0x1234));
+    BENCH_BLIT("clear", N_BLITS / 100, SCREEN_W * SCREEN_H,
+        blit_clear(&screen, 0x1234));
+    BENCH_BLIT("sprite 16x16", N_BLITS, SPRITE_SIZE * SPRITE_SIZE,
+        blit_sprite(&screen, x, y, &sprite));
+    BENCH_BLIT("rle 16x16", N_BLITS, SPRITE_SIZE * SPRITE_SIZE,
+        blit_rle(&screen, x, y, &rle_sprite));
+}
+
+/* Compares drawing into cached RAM against the uncached framebuffer */
+void bench_framebuffer(void)
+{
+    struct fb_var_screeninfo var;
+    struct fb_fix_screeninfo fix;
+    size_t size;
+    void *pixels;
+    Surface fb;
+    int fd = open("/dev/fb0", O_RDWR);
+
+    if (fd == -1)
+    {
+        printf("No /dev/fb0, skipping framebuffer blits\n");
+        return;
+    }
+
+    if (ioctl(fd, FBIOGET_VSCREENINFO, &var) == -1 ||
+        ioctl(fd, FBIOGET_FSCREENINFO, &fix) == -1)
+    {
+        printf("Failed to read framebuffer geometry, skipping\n");
+        close(fd);
+        return;
+    }
+
+    size = fix.line_length * var.yres;
+    pixels = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (pixels == MAP_FAILED ||
+        surface_init(&fb, pixels, var.xres, var.yres, fix.line_length,
+            var.bits_per_pixel))
+    {
+        printf("Failed to map framebuffer, skipping framebuffer blits\n");
+        close(fd);
+        return;
+    }
+    init_blit(var.bits_per_pixel);
+
+    printf("%-16s %12s\n", "target", "Mpixels/s");
+    BENCH_BLIT("ram fill 10x10", N_BLITS, 100,
+        blit_fill(&screen, x, y, 10, 10, 0x1234));
+    BENCH_BLIT("fb fill 10x10", N_BLITS, 100,
+        blit_fill(&fb, x, y, 10, 10, 0x1234));
+    BENCH_BLIT("ram clear", N_BLITS / 100, SCREEN_W * SCREEN_H,
+        blit_clear(&screen, 0x1234));
+    BENCH_BLIT("fb clear", N_BLITS / 100, var.xres * var.yres,
+        blit_clear(&fb, 0x1234));
+
+    munmap(pixels, size);
+    close(fd);
+}
+
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Batched games
+ *
+ *----------------------------------------------------------------------------*/
+
+
+/* Returns autopilot steps per second over N_GAMES games on 'n_workers'
+   threads, the games and score played are returned for comparison */
+double bench_batch_run(int n_workers, long *games, long *score)
+{
+    Batch batch;
+    Pool pool;
+    double start, seconds;
+
+    if (pool_init(&pool, n_workers))
+        return 0;
+    if (batch_init(&batch, N_GAMES, N_SQUARES_X, N_SQUARES_Y, n_workers,
+        1))
+    {
+        pool_free(&pool);
+        return 0;
+    }
+
+    start = walltime();
+    batch_run(&batch, &pool, N_STEPS);
+    seconds = walltime() - start;
+
+    batch_totals(&batch, games, score);
+    batch_free(&batch);
+    pool_free(&pool);
+
+    return (double)N_GAMES * N_STEPS / seconds;
+}
+
+void bench_batch(void)
+{
+    int cores = sysconf(_SC_NPROCESSORS_ONLN);
+    double base = 0;
+    double rate;
+    long games, score;
+
+    if (cores > POOL_MAX_WORKERS)
+        cores = POOL_MAX_WORKERS;
+
+    printf("%-8s %12s %8s %8s %8s\n", "threads", "steps/s", "speedup",
+        "games", "score");
+    for (int n = 1; n <= cores; n = n < cores && n * 2 > cores ? cores : n * 2)
+    {
+        rate = bench_batch_run(n, &games, &score);
+        if (n == 1)
+            base = rate;
+        printf("%-8d %12.0f %8.2f %8ld %8ld\n", n, rate, rate / base,
+            games, score);
+    }
+}
+
+/*------------------------------------------------------------------------------
+ *
+ * Synth
+ *
+ *----------------------------------------------------------------------------*/
+
+
+/* Returns samples rendered per second with a looped song of 'wave' on
+   every voice */
+double bench_synth_run(int wave)
+{
+    static const Note notes[] = {
+        { 262, 120 }, { 330, 80 }, { 0, 50 }, { 392, 200 }, { 1046, 30 }
+    };
+    Song song = { notes, 5, wave, 1 };
+    int16_t samples[SYNTH_PERIOD];
+    int32_t sum = 0;
+    Synth synth;
+    double start;
+    long n = (long)SYNTH_RATE * SYNTH_SECONDS / SYNTH_PERIOD;
+
+    synth_init(&synth, SYNTH_RATE);
+    for (int v = 0; v < SYNTH_VOICES; v++)
+        synth_play(&synth, v, &song);
+
+    start = walltime();
+    for (long i = 0; i < n; i++)
+    {
+        synth_render(&synth, samples, SYNTH_PERIOD);
+        sum += samples[i % SYNTH_PERIOD];
+    }
+
+    /* Keeps the rendering from being optimized away */
+    if (sum == 1)
+        printf(" ");
+
+    return n * SYNTH_PERIOD / (walltime() - start);
+}
+
+void bench_synth(void)
+{
+    double square = bench_synth_run(WAVE_SQUARE);
+    double saw = bench_synth_run(WAVE_SAW);
+
+    printf("%-8s %12s %12s\n", "wave", "Msamples/s", "realtime");
+    printf("%-8s %12.1f %12.0f\n", "square", square * 1.0e-6,
+        square / SYNTH_RATE);
+    printf("%-8s %12.1f %12.0f\n", "saw", saw * 1.0e-6, saw / SYNTH_RATE);
+}
+
+/* Checks that the autopilot finishes games on boards with odd sides, where
+   it used to chase its tail forever
+
+   Returns 1 if it did not on some size.
+*/
+int check_odd_boards(void)
+{
+    static const int sizes[][2] = { { 32, 23 }, { 31, 23 }, { 10, 9 } };
+    Batch batch;
+    Pool pool;
+    long games, score;
+    int failed = 0;
+
+    if (pool_init(&pool, 1))
+        return 1;
+
+    printf("%-8s %8s %8s\n", "board", "games", "score");
+    for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        if (batch_init(&batch, N_ODD_GAMES, sizes[i][0], sizes[i][1], 1, 1))
+        {
+            failed = 1;
+            break;
+        }
+
+        batch_run(&batch, &pool, N_ODD_STEPS);
+        batch_totals(&batch, &games, &score);
+        batch_free(&batch);
+
+        printf("%2dx%-5d %8ld %8ld%s\n", sizes[i][0], sizes[i][1], games,
+            score, games == 0 ? "  no game finished" : "");
+        if (games == 0)
+            failed = 1;
+    }
+
+    pool_free(&pool);
+
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    if (snake_create(&snake, N_SQUARES_X, N_SQUARES_Y))
+        return 1;
+
+    bench_snake();
+    bench_apple();
+    bench_blit(16);
+    bench_blit(32);
+    bench_framebuffer();
+    bench_batch();
+    bench_synth();
+
+    return check_odd_boards();
+}
@@ -0,0 +1,97 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "blit.h"
+
+/* Native machine word, allowed to alias the pixels it is stored over */
+typedef unsigned long __attribute__((__may_alias__)) word_t;
+
+/* Clips the rectangle at ('x', 'y') to the surface
+
+   Returns 0 if nothing is left. Otherwise the rectangle is updated and
+   'dx', 'dy' tell how far its origin moved.
+*/
+static int clip(const Surface *surface, int *x, int *y, int *w, int *h,
+    int *dx, int *dy)
+{
+    *dx = *x < 0 ? -*x : 0;
+    *dy = *y < 0 ? -*y : 0;
+    *x += *dx;
+    *y += *dy;
+    *w -= *dx;
+    *h -= *dy;
+
+    if (*x + *w > surface->width)
+        *w = surface->width - *x;
+    if (*y + *h > surface->height)
+        *h = surface->height - *y;
+
+    return *w > 0 && *h > 0;
+}
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Renderers
+ *
+ *----------------------------------------------------------------------------*/
+
+
+#define BLIT_BITS 16
+#include "blit_impl.h"
+#undef BLIT_BITS
+
+#define BLIT_BITS 32
+#include "blit_impl.h"
+#undef BLIT_BITS
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Surfaces and formats
+ *
+ *----------------------------------------------------------------------------*/
+
+
+/* Sets up 'surface' with the renderer for 'bits_per_pixel'
+
+   Returns 1 if the pixel size is not supported.
+*/
+int surface_init(Surface *surface, void *pixels, int width, int height,
+    int stride, int bits_per_pixel)
+{
+    surface->pixels = pixels;
+    surface->width = width;
+    surface->height = height;
+    surface->stride = stride;
+
+    switch (bits_per_pixel)
+    {
+    case 16:
+        surface->renderer = &renderer_16;
+        return 0;
+    case 32:
+        surface->renderer = &renderer_32;
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Converts the 24-bit color 'rgb' (0xRRGGBB) to a pixel value in 'format' */
+pixel_t format_color(const Format *format, uint32_t rgb)
+{
+    uint32_t r = (rgb >> 16) & 0xff;
+    uint32_t g = (rgb >> 8) & 0xff;
+    uint32_t b = rgb & 0xff;
+
+    return (r >> (8 - format->red_length)) << format->red_offset |
+        (g >> (8 - format->green_length)) << format->green_offset |
+        (b >> (8 - format->blue_length)) << format->blue_offset;
+}
@@ -0,0 +1,111 @@
+#ifndef BLIT_H
+#define BLIT_H
+
+#include <inttypes.h>
+
+/* Pixel value in the format of the surface it is drawn on */
+typedef uint32_t pixel_t;
+
+typedef struct Format Format;
+typedef struct Renderer Renderer;
+typedef struct Surface Surface;
+typedef struct Sprite Sprite;
+typedef struct Run Run;
+typedef struct RleSprite RleSprite;
+
+/* Pixel layout, channel offsets and lengths are in bits */
+struct Format
+{
+    int bits_per_pixel;
+    int red_offset;
+    int red_length;
+    int green_offset;
+    int green_length;
+    int blue_offset;
+    int blue_length;
+};
+
+/* Pixel rectangle, rows are 'stride' bytes apart */
+struct Surface
+{
+    uint8_t *pixels;
+    int width;
+    int height;
+    int stride;
+    const Renderer *renderer;
+};
+
+/* Raw sprite with rows packed in the format of the surface it is drawn on,
+   pixels equal to 'key' are transparent */
+struct Sprite
+{
+    const void *pixels;
+    int width;
+    int height;
+    pixel_t key;
+};
+
+/* Horizontal run of 'length' pixels of one color */
+struct Run
+{
+    uint16_t length;
+    pixel_t color;
+};
+
+/* Run-length encoded sprite, the runs of each row add up to 'width' and
+   runs in the 'key' color are skipped */
+struct RleSprite
+{
+    const Run *runs;
+    int n_runs;
+    int width;
+    int height;
+    pixel_t key;
+};
+
+/* Primitives specialized for one pixel size, picked once per surface so the
+   pixel loops carry no format checks */
+struct Renderer
+{
+    int bits_per_pixel;
+    void (*fill)(Surface *surface, int x, int y, int w, int h, pixel_t color);
+    void (*clear)(Surface *surface, pixel_t color);
+    void (*sprite)(Surface *surface, int x, int y, const Sprite *sprite);
+    void (*rle)(Surface *surface, int x, int y, const RleSprite *sprite);
+    int (*rle_encode)(const Sprite *sprite, Run *runs, int max_runs);
+};
+
+int surface_init(Surface *surface, void *pixels, int width, int height,
+    int stride, int bits_per_pixel);
+pixel_t format_color(const Format *format, uint32_t rgb);
+
+static inline void blit_fill(Surface *surface, int x, int y, int w, int h,
+    pixel_t color)
+{
+    surface->renderer->fill(surface, x, y, w, h, color);
+}
+
+static inline void blit_clear(Surface *surface, pixel_t color)
+{
+    surface->renderer->clear(surface, color);
+}
+
+static inline void blit_sprite(Surface *surface, int x, int y,
+    const Sprite *sprite)
+{
+    surface->renderer->sprite(surface, x, y, sprite);
+}
+
+static inline void blit_rle(Surface *surface, int x, int y,
+    const RleSprite *sprite)
+{
+    surface->renderer->rle(surface, x, y, sprite);
+}
+
+static inline int rle_encode(const Surface *surface, const Sprite *sprite,
+    Run *runs, int max_runs)
+{
+    return surface->renderer->rle_encode(sprite, runs, max_runs);
+}
+
+#endif /* BLIT_H */
@@ -0,0 +1,240 @@
+/* Blitter primitives for one pixel size
+
+   Included by blit.c once per supported size with BLIT_BITS set to 16 or 32,
+   defining the renderer 'renderer_<BLIT_BITS>'.
+*/
+
+#define CONCAT_(a, b) a##_##b
+#define CONCAT(a, b) CONCAT_(a, b)
+#define NAME(name) CONCAT(name, BLIT_BITS)
+
+#if BLIT_BITS == 16
+#define PIXEL uint16_t
+#define SSE_SET1(c) _mm_set1_epi16((short)(c))
+#define SSE_CMPEQ _mm_cmpeq_epi16
+#define NEON_VECTOR uint16x8_t
+#define NEON_DUP vdupq_n_u16
+#define NEON_LOAD vld1q_u16
+#define NEON_STORE vst1q_u16
+#define NEON_CMPEQ vceqq_u16
+#define NEON_SELECT vbslq_u16
+#elif BLIT_BITS == 32
+#define PIXEL uint32_t
+#define SSE_SET1(c) _mm_set1_epi32((int)(c))
+#define SSE_CMPEQ _mm_cmpeq_epi32
+#define NEON_VECTOR uint32x4_t
+#define NEON_DUP vdupq_n_u32
+#define NEON_LOAD vld1q_u32
+#define NEON_STORE vst1q_u32
+#define NEON_CMPEQ vceqq_u32
+#define NEON_SELECT vbslq_u32
+#else
+#error "Unsupported BLIT_BITS"
+#endif
+
+#define PIXELS_PER_WORD (int)(sizeof(word_t) / sizeof(PIXEL))
+#define PIXELS_PER_VECTOR (int)(16 / sizeof(PIXEL))
+
+/* Sets 'n' pixels starting at 'p' to 'color'
+
+   Single pixels are stored until 'p' is word aligned, then the color is
+   replicated across a word, or a vector register where available, so most
+   of the span is written with wide aligned stores.
+*/
+static void NAME(fill_span)(PIXEL *p, int n, PIXEL color)
+{
+    word_t pattern = (word_t)color * (~(word_t)0 / (PIXEL)~0);
+
+    if (n < 2 * PIXELS_PER_WORD)
+    {
+        while (n-- > 0)
+            *p++ = color;
+        return;
+    }
+
+    while (n > 0 && ((uintptr_t)p % sizeof(word_t)) != 0)
+    {
+        *p++ = color;
+        n--;
+    }
+
+#if defined(__SSE2__)
+    while (n >= PIXELS_PER_VECTOR && ((uintptr_t)p % 16) != 0)
+    {
+        *(word_t*)p = pattern;
+        p += PIXELS_PER_WORD;
+        n -= PIXELS_PER_WORD;
+    }
+    __m128i vector = SSE_SET1(color);
+    for (; n >= PIXELS_PER_VECTOR; n -= PIXELS_PER_VECTOR, p += PIXELS_PER_VECTOR)
+        _mm_store_si128((__m128i*)p, vector);
+#elif defined(__ARM_NEON)
+    NEON_VECTOR vector = NEON_DUP(color);
+    for (; n >= PIXELS_PER_VECTOR; n -= PIXELS_PER_VECTOR, p += PIXELS_PER_VECTOR)
+        NEON_STORE(p, vector);
+#endif
+
+    for (; n >= PIXELS_PER_WORD; n -= PIXELS_PER_WORD, p += PIXELS_PER_WORD)
+        *(word_t*)p = pattern;
+
+    while (n-- > 0)
+        *p++ = color;
+}
+
+/* Copies 'n' pixels from 'src' to 'dst', skipping those equal to 'key' */
+static void NAME(key_span)(PIXEL *dst, const PIXEL *src, int n, PIXEL key)
+{
+#if defined(__SSE2__)
+    __m128i keys = SSE_SET1(key);
+    for (; n >= PIXELS_PER_VECTOR;
+        n -= PIXELS_PER_VECTOR, dst += PIXELS_PER_VECTOR, src += PIXELS_PER_VECTOR)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i*)src);
+        __m128i d = _mm_loadu_si128((const __m128i*)dst);
+        __m128i transparent = SSE_CMPEQ(s, keys);
+        _mm_storeu_si128((__m128i*)dst, _mm_or_si128(
+            _mm_and_si128(transparent, d), _mm_andnot_si128(transparent, s)));
+    }
+#elif defined(__ARM_NEON)
+    NEON_VECTOR keys = NEON_DUP(key);
+    for (; n >= PIXELS_PER_VECTOR;
+        n -= PIXELS_PER_VECTOR, dst += PIXELS_PER_VECTOR, src += PIXELS_PER_VECTOR)
+    {
+        NEON_VECTOR s = NEON_LOAD(src);
+        NEON_VECTOR transparent = NEON_CMPEQ(s, keys);
+        NEON_STORE(dst, NEON_SELECT(transparent, NEON_LOAD(dst), s));
+    }
+#endif
+
+    for (; n > 0; n--, dst++, src++)
+        if (*src != key)
+            *dst = *src;
+}
+
+/* Fills a rectangle row by row */
+static void NAME(fill)(Surface *surface, int x, int y, int w, int h,
+    pixel_t color)
+{
+    uint8_t *row;
+    int dx, dy;
+
+    if (!clip(surface, &x, &y, &w, &h, &dx, &dy))
+        return;
+
+    row = surface->pixels + y * surface->stride + x * sizeof(PIXEL);
+    for (int j = 0; j < h; j++, row += surface->stride)
+        NAME(fill_span)((PIXEL*)row, w, color);
+}
+
+/* Fills the whole surface, as one span when the rows are contiguous */
+static void NAME(clear)(Surface *surface, pixel_t color)
+{
+    if (surface->stride == surface->width * (int)sizeof(PIXEL))
+        NAME(fill_span)((PIXEL*)surface->pixels,
+            surface->width * surface->height, color);
+    else
+        NAME(fill)(surface, 0, 0, surface->width, surface->height, color);
+}
+
+static void NAME(sprite)(Surface *surface, int x, int y, const Sprite *sprite)
+{
+    const PIXEL *src;
+    uint8_t *dst;
+    int w = sprite->width;
+    int h = sprite->height;
+    int dx, dy;
+
+    if (!clip(surface, &x, &y, &w, &h, &dx, &dy))
+        return;
+
+    src = (const PIXEL*)sprite->pixels + dy * sprite->width + dx;
+    dst = surface->pixels + y * surface->stride + x * sizeof(PIXEL);
+    for (int j = 0; j < h; j++)
+    {
+        NAME(key_span)((PIXEL*)dst, src, w, sprite->key);
+        src += sprite->width;
+        dst += surface->stride;
+    }
+}
+
+/* Draws each opaque run as a solid span, clipped to the surface */
+static void NAME(rle)(Surface *surface, int x, int y, const RleSprite *sprite)
+{
+    const Run *run = sprite->runs;
+    const Run *end = sprite->runs + sprite->n_runs;
+    PIXEL *row;
+    int x0, x1;
+
+    for (int j = 0; j < sprite->height && run < end; j++)
+    {
+        int visible = y + j >= 0 && y + j < surface->height;
+        int i = x;
+
+        row = visible ?
+            (PIXEL*)(surface->pixels + (y + j) * surface->stride) : NULL;
+        for (; i < x + sprite->width && run < end; run++)
+        {
+            x0 = i < 0 ? 0 : i;
+            x1 = i + run->length;
+            if (x1 > surface->width)
+                x1 = surface->width;
+            if (visible && run->color != sprite->key && x1 > x0)
+                NAME(fill_span)(row + x0, x1 - x0, run->color);
+            i += run->length;
+        }
+    }
+}
+
+/* Encodes 'sprite' into at most 'max_runs' runs, no run crosses a row
+
+   Returns the number of runs, or -1 if they do not fit.
+*/
+static int NAME(rle_encode)(const Sprite *sprite, Run *runs, int max_runs)
+{
+    const PIXEL *p = sprite->pixels;
+    int n = 0;
+
+    for (int j = 0; j < sprite->height; j++)
+    {
+        for (int i = 0; i < sprite->width; n++)
+        {
+            if (n == max_runs)
+                return -1;
+
+            runs[n].color = p[i];
+            runs[n].length = 0;
+            while (i < sprite->width && p[i] == runs[n].color)
+            {
+                runs[n].length++;
+                i++;
+            }
+        }
+        p += sprite->width;
+    }
+
+    return n;
+}
+
+static const Renderer NAME(renderer) = {
+    BLIT_BITS,
+    NAME(fill),
+    NAME(clear),
+    NAME(sprite),
+    NAME(rle),
+    NAME(rle_encode)
+};
+
+#undef PIXEL
+#undef SSE_SET1
+#undef SSE_CMPEQ
+#undef NEON_VECTOR
+#undef NEON_DUP
+#undef NEON_LOAD
+#undef NEON_STORE
+#undef NEON_CMPEQ
+#undef NEON_SELECT
+#undef PIXELS_PER_WORD
+#undef PIXELS_PER_VECTOR
+#undef NAME
+#undef CONCAT
+#undef CONCAT_
@@ -0,0 +1,139 @@
+#include <string.h>
+
+#include "damage.h"
+
+static Rect rects[DAMAGE_MAX_RECTS];
+static int n_rects = 0;
+static int full = 0;
+
+static int screen_w;
+static int screen_h;
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Rectangle helpers
+ *
+ *----------------------------------------------------------------------------*/
+
+
+static int area(const Rect *r)
+{
+    return r->w * r->h;
+}
+
+static Rect bounds(const Rect *a, const Rect *b)
+{
+    Rect r;
+    int x1 = a->x + a->w > b->x + b->w ? a->x + a->w : b->x + b->w;
+    int y1 = a->y + a->h > b->y + b->h ? a->y + a->h : b->y + b->h;
+
+    r.x = a->x < b->x ? a->x : b->x;
+    r.y = a->y < b->y ? a->y : b->y;
+    r.w = x1 - r.x;
+    r.h = y1 - r.y;
+
+    return r;
+}
+
+/* Merges 'b' into 'a' when their bounding box covers no more pixels than
+   the areas of the two added up, so a merge never flushes more than the
+   separate rectangles would. This takes in one rectangle nested in the
+   other, aligned neighbours sharing an edge and aligned strips that overlap,
+   but not crossing or L-shaped overlaps whose box is larger */
+static int try_merge(Rect *a, const Rect *b)
+{
+    Rect r = bounds(a, b);
+
+    if (area(&r) > area(a) + area(b))
+        return 0;
+
+    *a = r;
+    return 1;
+}
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Damage tracking
+ *
+ *----------------------------------------------------------------------------*/
+
+
+void damage_init(int width, int height)
+{
+    screen_w = width;
+    screen_h = height;
+    n_rects = 0;
+    full = 0;
+}
+
+/* Records a changed region, merging it with the regions it touches */
+void damage_add(int x, int y, int width, int height)
+{
+    Rect r = { x, y, width, height };
+    int total = 0;
+    int i = 0;
+
+    if (full)
+        return;
+
+    /* A merge grows 'r', which may let it absorb regions already passed */
+    while (i < n_rects)
+    {
+        if (try_merge(&r, &rects[i]))
+        {
+            rects[i] = rects[--n_rects];
+            i = 0;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    if (n_rects == DAMAGE_MAX_RECTS)
+    {
+        full = 1;
+        return;
+    }
+    rects[n_rects++] = r;
+
+    for (i = 0; i < n_rects; i++)
+        total += area(&rects[i]);
+    if (total * 100 > screen_w * screen_h * DAMAGE_FULL_PERCENT)
+        full = 1;
+}
+
+void damage_add_all(void)
+{
+    full = 1;
+}
+
+/* Copies the damaged regions to 'rects' and clears them
+
+   'rects' must hold DAMAGE_MAX_RECTS entries. Returns the number of regions,
+   a full screen flush being a single region covering the screen.
+*/
+int damage_collect(Rect *rects_out)
+{
+    int n = n_rects;
+
+    if (full)
+    {
+        rects_out[0].x = 0;
+        rects_out[0].y = 0;
+        rects_out[0].w = screen_w;
+        rects_out[0].h = screen_h;
+        n = 1;
+    }
+    else
+    {
+        memcpy(rects_out, rects, n * sizeof(Rect));
+    }
+
+    n_rects = 0;
+    full = 0;
+
+    return n;
+}
@@ -0,0 +1,25 @@
+#ifndef DAMAGE_H
+#define DAMAGE_H
+
+/* Regions tracked before falling back to a full screen flush */
+#define DAMAGE_MAX_RECTS 16
+
+/* Damaged share of the screen, in percent, that triggers a full flush */
+#define DAMAGE_FULL_PERCENT 50
+
+typedef struct Rect Rect;
+
+struct Rect
+{
+    int x;
+    int y;
+    int w;
+    int h;
+};
+
+void damage_init(int width, int height);
+void damage_add(int x, int y, int width, int height);
+void damage_add_all(void);
+int damage_collect(Rect *rects);
+
+#endif /* DAMAGE_H */
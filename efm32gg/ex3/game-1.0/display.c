@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "display.h"
+#include "damage.h"
+
+Surface screen;
+Format screen_format;
+
+static const DisplayBackend *backends[] = {
+    &display_efm32,
+    &display_fbdev,
+    &display_headless
+};
+
+static const DisplayBackend *backend = NULL;
+
+/* Sets up the backend called 'name'
+
+   Returns 1 if there is no such backend or it fails to start.
+*/
+int display_init(const char *name, const DisplayOptions *options)
+{
+    for (int i = 0; i < sizeof(backends) / sizeof(backends[0]); i++)
+        if (strcmp(backends[i]->name, name) == 0)
+            backend = backends[i];
+
+    if (backend == NULL)
+    {
+        printf("Unknown display backend '%s'\n", name);
+        return 1;
+    }
+
+    if (backend->init(options))
+        return 1;
+
+    damage_init(screen.width, screen.height);
+
+    return 0;
+}
+
+/* Hands the damage of the frame to the backend */
+void display_present(void)
+{
+    Rect rects[DAMAGE_MAX_RECTS];
+    int n = damage_collect(rects);
+
+    backend->present(rects, n);
+}
+
+/* Shuts the backend down, returns nonzero if it found a problem with the
+   frames it was given */
+int display_close(void)
+{
+    return backend->close();
+}
@@ -0,0 +1,48 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include "blit.h"
+#include "damage.h"
+
+typedef struct DisplayOptions DisplayOptions;
+typedef struct DisplayBackend DisplayBackend;
+
+struct DisplayOptions
+{
+    /* Framebuffer backends: draw into RAM and present by flip or copy */
+    int double_buffer;
+
+    /* Headless backend: surface geometry, and optional per frame PPM dumps
+       into 'dump_dir', checksums written to 'checksum_path' or compared
+       against those in 'golden_path' */
+    int width;
+    int height;
+    int bits_per_pixel;
+    const char *dump_dir;
+    const char *checksum_path;
+    const char *golden_path;
+};
+
+/* Display implementation, 'init' sets up 'screen' and 'screen_format' and
+   'present' is handed the damaged regions of every frame */
+struct DisplayBackend
+{
+    const char *name;
+    int (*init)(const DisplayOptions *options);
+    void (*present)(const Rect *rects, int n);
+    int (*close)(void);
+};
+
+extern const DisplayBackend display_efm32;
+extern const DisplayBackend display_fbdev;
+extern const DisplayBackend display_headless;
+
+/* Surface the game draws into */
+extern Surface screen;
+extern Format screen_format;
+
+int display_init(const char *name, const DisplayOptions *options);
+void display_present(void);
+int display_close(void);
+
+#endif /* DISPLAY_H */
@@ -0,0 +1,270 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 1
+#define _GNU_SOURCE 1
+#endif /* _POSIX_C_SOURCE */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+
+#include "display.h"
+#include "damage.h"
+
+/* EFM32GG framebuffer ioctl that pushes a region to the display */
+#define FB_EFM32_COPYAREA 0x4680
+
+/* Set for the EFM32GG driver, which needs every region pushed explicitly */
+static int fb_flush = 0;
+
+static int fb_fd = -1;
+static uint8_t *fb_pixels = NULL;
+static size_t fb_size = 0;
+static struct fb_var_screeninfo fb_var;
+static struct fb_fix_screeninfo fb_fix;
+
+/* Back buffer state, 'page' is the framebuffer page being scanned out and
+   'prev_rects' the damage presented with it */
+static uint8_t *back_buffer = NULL;
+static int flipping = 0;
+static int page = 0;
+static Rect prev_rects[DAMAGE_MAX_RECTS];
+static int n_prev = 0;
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Framebuffer helpers
+ *
+ *----------------------------------------------------------------------------*/
+
+
+/* Sets up a virtual screen twice the visible height so frames can be
+   presented by panning between its two pages
+
+   Returns 1 if the driver supports it.
+*/
+static int init_flipping(size_t page_size)
+{
+    struct fb_fix_screeninfo fix;
+
+    if (fb_var.yres_virtual < 2 * fb_var.yres)
+    {
+        fb_var.yres_virtual = 2 * fb_var.yres;
+        if (ioctl(fb_fd, FBIOPUT_VSCREENINFO, &fb_var) == -1 ||
+            ioctl(fb_fd, FBIOGET_VSCREENINFO, &fb_var) == -1 ||
+            fb_var.yres_virtual < 2 * fb_var.yres)
+            return 0;
+    }
+
+    if (ioctl(fb_fd, FBIOGET_FSCREENINFO, &fix) == -1 ||
+        fix.smem_len < 2 * page_size)
+        return 0;
+
+    fb_var.yoffset = 0;
+    return ioctl(fb_fd, FBIOPAN_DISPLAY, &fb_var) != -1;
+}
+
+/* Reads the geometry and pixel format of the framebuffer
+
+   Returns 1 if the renderers do not support the format.
+*/
+static int init_format(void)
+{
+    if (ioctl(fb_fd, FBIOGET_VSCREENINFO, &fb_var) == -1 ||
+        ioctl(fb_fd, FBIOGET_FSCREENINFO, &fb_fix) == -1)
+    {
+        printf("Failed to read display geometry\n");
+        return 1;
+    }
+
+    screen_format.bits_per_pixel = fb_var.bits_per_pixel;
+    screen_format.red_offset = fb_var.red.offset;
+    screen_format.red_length = fb_var.red.length;
+    screen_format.green_offset = fb_var.green.offset;
+    screen_format.green_length = fb_var.green.length;
+    screen_format.blue_offset = fb_var.blue.offset;
+    screen_format.blue_length = fb_var.blue.length;
+
+    if (fb_fix.type != FB_TYPE_PACKED_PIXELS ||
+        fb_fix.visual != FB_VISUAL_TRUECOLOR ||
+        fb_var.red.length > 8 || fb_var.green.length > 8 ||
+        fb_var.blue.length > 8)
+    {
+        printf("Unsupported pixel format\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Copies the region 'r' of the back buffer to 'dst' */
+static void copy_rect(uint8_t *dst, const Rect *r)
+{
+    int bytes = screen_format.bits_per_pixel / 8;
+    int offset = r->y * screen.stride + r->x * bytes;
+
+    for (int j = 0; j < r->h; j++, offset += screen.stride)
+        memcpy(dst + offset, screen.pixels + offset, r->w * bytes);
+}
+
+/* Pushes the region 'r' of the framebuffer to the display, generic drivers
+   scan out the framebuffer memory directly and need no push */
+static void flush_rect(const Rect *r)
+{
+    struct fb_copyarea region;
+
+    if (!fb_flush)
+        return;
+
+    region.dx = region.sx = r->x;
+    region.dy = region.sy = r->y;
+    region.width = r->w;
+    region.height = r->h;
+
+    ioctl(fb_fd, FB_EFM32_COPYAREA, &region);
+}
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Framebuffer backends
+ *
+ *----------------------------------------------------------------------------*/
+
+
+/* Maps the framebuffer and sets up 'screen' in its geometry and format
+
+   With 'double_buffer' set the game draws into cached RAM and frames are
+   presented by page flipping, or by copying the damaged regions into the
+   framebuffer when the driver cannot pan.
+*/
+static int fb_init(int double_buffer)
+{
+    size_t page_size;
+
+    fb_fd = open("/dev/fb0", O_RDWR);
+
+    if (fb_fd == -1)
+    {
+        printf("Failed to open display driver\n");
+        return 1;
+    }
+
+    if (init_format())
+        return 1;
+
+    page_size = fb_fix.line_length * fb_var.yres;
+
+    if (double_buffer)
+    {
+        back_buffer = malloc(page_size);
+        if (back_buffer == NULL)
+        {
+            printf("Failed to allocate back buffer\n");
+            return 1;
+        }
+        flipping = init_flipping(page_size);
+    }
+
+    fb_size = flipping ? 2 * page_size : page_size;
+    fb_pixels = (uint8_t*)mmap(NULL, fb_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED, fb_fd, 0);
+
+    if (fb_pixels == MAP_FAILED)
+    {
+        printf("Failed to map pixel array to framebuffer\n");
+        return 1;
+    }
+
+    if (surface_init(&screen, back_buffer ? back_buffer : fb_pixels,
+        fb_var.xres, fb_var.yres, fb_fix.line_length, fb_var.bits_per_pixel))
+    {
+        printf("Unsupported pixel size\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+static int efm32_init(const DisplayOptions *options)
+{
+    fb_flush = 1;
+    return fb_init(options->double_buffer);
+}
+
+static int fbdev_init(const DisplayOptions *options)
+{
+    fb_flush = 0;
+    return fb_init(options->double_buffer);
+}
+
+/* Makes the damaged regions visible
+
+   The hidden page last showed the frame before the current one, so a flip
+   first brings it up to date with the damage of both frames.
+*/
+static void fb_present(const Rect *rects, int n)
+{
+    uint8_t *hidden;
+
+    if (n == 0)
+        return;
+
+    if (back_buffer == NULL)
+    {
+        for (int i = 0; i < n; i++)
+            flush_rect(&rects[i]);
+    }
+    else if (flipping)
+    {
+        hidden = fb_pixels + (1 - page) * screen.stride * screen.height;
+        for (int i = 0; i < n_prev; i++)
+            copy_rect(hidden, &prev_rects[i]);
+        for (int i = 0; i < n; i++)
+            copy_rect(hidden, &rects[i]);
+
+        page = 1 - page;
+        fb_var.yoffset = page * fb_var.yres;
+        ioctl(fb_fd, FBIOPAN_DISPLAY, &fb_var);
+
+        memcpy(prev_rects, rects, n * sizeof(Rect));
+        n_prev = n;
+    }
+    else
+    {
+        for (int i = 0; i < n; i++)
+        {
+            copy_rect(fb_pixels, &rects[i]);
+            flush_rect(&rects[i]);
+        }
+    }
+}
+
+static int fb_close(void)
+{
+    if (flipping && page != 0)
+    {
+        fb_var.yoffset = 0;
+        ioctl(fb_fd, FBIOPAN_DISPLAY, &fb_var);
+    }
+
+    munmap(fb_pixels, fb_size);
+    free(back_buffer);
+    close(fb_fd);
+
+    return 0;
+}
+
+const DisplayBackend display_efm32 = {
+    "efm32", efm32_init, fb_present, fb_close
+};
+
+const DisplayBackend display_fbdev = {
+    "fbdev", fbdev_init, fb_present, fb_close
+};
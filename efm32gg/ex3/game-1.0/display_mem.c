@@ -0,0 +1,197 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 1
+#define _GNU_SOURCE 1
+#endif /* _POSIX_C_SOURCE */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "display.h"
+
+static uint8_t *pixels = NULL;
+
+static const char *dump_dir = NULL;
+static FILE *checksum_file = NULL;
+static FILE *golden_file = NULL;
+
+static int frame = 0;
+static int mismatches = 0;
+static int first_mismatch = -1;
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Frame output
+ *
+ *----------------------------------------------------------------------------*/
+
+
+/* Returns the FNV-1a hash of the visible pixels */
+static uint32_t checksum(void)
+{
+    uint32_t hash = 2166136261U;
+    int bytes = screen.width * screen_format.bits_per_pixel / 8;
+
+    for (int j = 0; j < screen.height; j++)
+    {
+        const uint8_t *row = screen.pixels + j * screen.stride;
+        for (int i = 0; i < bytes; i++)
+            hash = (hash ^ row[i]) * 16777619U;
+    }
+
+    return hash;
+}
+
+/* Expands the 'length' bit channel at 'offset' in 'pixel' to 8 bits */
+static uint8_t channel(pixel_t pixel, int offset, int length)
+{
+    uint32_t c = (pixel >> offset) & ((1U << length) - 1);
+    return (c << (8 - length)) | (c >> (2 * length - 8));
+}
+
+/* Writes the screen to 'dump_dir' as a binary PPM named after the frame */
+static void dump_frame(void)
+{
+    char path[4096];
+    pixel_t pixel;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/frame%06d.ppm", dump_dir, frame);
+    f = fopen(path, "wb");
+    if (f == NULL)
+        return;
+
+    fprintf(f, "P6\n%d %d\n255\n", screen.width, screen.height);
+    for (int j = 0; j < screen.height; j++)
+    {
+        const uint8_t *row = screen.pixels + j * screen.stride;
+        for (int i = 0; i < screen.width; i++)
+        {
+            if (screen_format.bits_per_pixel == 16)
+                pixel = ((const uint16_t*)row)[i];
+            else
+                pixel = ((const uint32_t*)row)[i];
+
+            fputc(channel(pixel, screen_format.red_offset,
+                screen_format.red_length), f);
+            fputc(channel(pixel, screen_format.green_offset,
+                screen_format.green_length), f);
+            fputc(channel(pixel, screen_format.blue_offset,
+                screen_format.blue_length), f);
+        }
+    }
+
+    fclose(f);
+}
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Headless backend
+ *
+ *----------------------------------------------------------------------------*/
+
+
+/* Sets up an in-memory RGB565 or XRGB8888 screen */
+static int headless_init(const DisplayOptions *options)
+{
+    int stride = options->width * options->bits_per_pixel / 8;
+
+    switch (options->bits_per_pixel)
+    {
+    case 16:
+        screen_format = (Format){ 16, 11, 5, 5, 6, 0, 5 };
+        break;
+    case 32:
+        screen_format = (Format){ 32, 16, 8, 8, 8, 0, 8 };
+        break;
+    default:
+        printf("Unsupported pixel size\n");
+        return 1;
+    }
+
+    pixels = calloc(options->height, stride);
+    if (pixels == NULL)
+    {
+        printf("Failed to allocate headless screen\n");
+        return 1;
+    }
+    surface_init(&screen, pixels, options->width, options->height, stride,
+        options->bits_per_pixel);
+
+    dump_dir = options->dump_dir;
+
+    if (options->checksum_path)
+    {
+        checksum_file = fopen(options->checksum_path, "w");
+        if (checksum_file == NULL)
+        {
+            printf("Failed to open checksum file\n");
+            return 1;
+        }
+    }
+
+    if (options->golden_path)
+    {
+        golden_file = fopen(options->golden_path, "r");
+        if (golden_file == NULL)
+        {
+            printf("Failed to open golden checksum file\n");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Records the frame, a frame missing from the golden file is a mismatch */
+static void headless_present(const Rect *rects, int n)
+{
+    unsigned int golden;
+    uint32_t sum;
+
+    if (checksum_file || golden_file)
+    {
+        sum = checksum();
+
+        if (checksum_file)
+            fprintf(checksum_file, "%08" PRIx32 "\n", sum);
+
+        if (golden_file &&
+            (fscanf(golden_file, "%x", &golden) != 1 || golden != sum))
+        {
+            if (mismatches++ == 0)
+                first_mismatch = frame;
+        }
+    }
+
+    if (dump_dir)
+        dump_frame();
+
+    frame++;
+}
+
+static int headless_close(void)
+{
+    if (checksum_file)
+        fclose(checksum_file);
+
+    if (golden_file)
+    {
+        fclose(golden_file);
+        if (mismatches)
+            printf("%d of %d frames differ from golden, first is frame %d\n",
+                mismatches, frame, first_mismatch);
+        else
+            printf("All %d frames match golden\n", frame);
+    }
+
+    free(pixels);
+
+    return mismatches != 0;
+}
+
+const DisplayBackend display_headless = {
+    "headless", headless_init, headless_present, headless_close
+};
@@ -0,0 +1,43 @@
+#include "engine.h"
+#include "rng.h"
+
+/* Game rules on one instance of the game state, which is passed in parts so
+   it can live in a struct of its own or be spread over arrays of many */
+
+/* Starts a game with a short snake in the middle of the board and the
+   apple on a random free cell */
+void engine_reset(Snake *snake, cell_t *apple, uint32_t *rng)
+{
+    snake_init(snake, snake->width / 2, snake->height / 2, 3);
+    *apple = snake_free_cell(snake, rng_next(rng));
+}
+
+/* Advances the game by one tick heading in 'direction'
+
+   Moving pushes the new head and pops the tail, which is returned in
+   'vacated', eating an apple skips the pop so the snake grows by one.
+   Returns ENGINE_DIED when the head hit the body and ENGINE_FULL when the
+   snake fills the board, the game must be reset after either.
+*/
+int engine_step(Snake *snake, cell_t *apple, uint32_t *rng, int direction,
+    cell_t *vacated)
+{
+    cell_t head = snake_next(snake, direction);
+
+    if (head == *apple)
+    {
+        snake_push(snake, head);
+        if (snake->n_free == 0)
+            return ENGINE_FULL;
+
+        *apple = snake_free_cell(snake, rng_next(rng));
+        return ENGINE_ATE;
+    }
+
+    *vacated = snake_pop(snake);
+    if (snake_collision(snake, head))
+        return ENGINE_DIED;
+
+    snake_push(snake, head);
+    return ENGINE_MOVED;
+}
@@ -0,0 +1,13 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "snake.h"
+
+/* Outcome of a tick */
+enum { ENGINE_MOVED, ENGINE_ATE, ENGINE_DIED, ENGINE_FULL };
+
+void engine_reset(Snake *snake, cell_t *apple, uint32_t *rng);
+int engine_step(Snake *snake, cell_t *apple, uint32_t *rng, int direction,
+    cell_t *vacated);
+
+#endif /* ENGINE_H */
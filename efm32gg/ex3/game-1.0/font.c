@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "font.h"
+
+/* Glyph rows top down, bit 4 is the leftmost pixel */
+static const uint8_t font_rows[FONT_CHARS][7] = {
+    ['%' - ' '] = { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },
+    ['-' - ' '] = { 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 },
+    ['.' - ' '] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c },
+    ['/' - ' '] = { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },
+    ['0' - ' '] = { 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e },
+    ['1' - ' '] = { 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e },
+    ['2' - ' '] = { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f },
+    ['3' - ' '] = { 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e },
+    ['4' - ' '] = { 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 },
+    ['5' - ' '] = { 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e },
+    ['6' - ' '] = { 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e },
+    ['7' - ' '] = { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },
+    ['8' - ' '] = { 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e },
+    ['9' - ' '] = { 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c },
+    [':' - ' '] = { 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 },
+    ['A' - ' '] = { 0x0e, 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11 },
+    ['B' - ' '] = { 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e },
+    ['C' - ' '] = { 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e },
+    ['D' - ' '] = { 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c },
+    ['E' - ' '] = { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f },
+    ['F' - ' '] = { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 },
+    ['G' - ' '] = { 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f },
+    ['H' - ' '] = { 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 },
+    ['I' - ' '] = { 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e },
+    ['J' - ' '] = { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c },
+    ['K' - ' '] = { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },
+    ['L' - ' '] = { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f },
+    ['M' - ' '] = { 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 },
+    ['N' - ' '] = { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },
+    ['O' - ' '] = { 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e },
+    ['P' - ' '] = { 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 },
+    ['Q' - ' '] = { 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d },
+    ['R' - ' '] = { 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 },
+    ['S' - ' '] = { 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e },
+    ['T' - ' '] = { 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },
+    ['U' - ' '] = { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e },
+    ['V' - ' '] = { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 },
+    ['W' - ' '] = { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a },
+    ['X' - ' '] = { 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 },
+    ['Y' - ' '] = { 0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04 },
+    ['Z' - ' '] = { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f },
+};
+
+/* Rasterizes every glyph in the pixel format of 'surface', 'fg' on 'bg'
+
+   The glyphs are drawn through the renderer of the surface itself, so the
+   font supports whatever pixel sizes the blitter does.
+*/
+int font_init(Font *font, const Surface *surface, pixel_t fg, pixel_t bg)
+{
+    int bytes = surface->renderer->bits_per_pixel / 8;
+    int glyph_size = FONT_WIDTH * FONT_HEIGHT * bytes;
+    pixel_t key = 0;
+    Surface glyph;
+
+    font->pixels = malloc(FONT_CHARS * glyph_size);
+    if (font->pixels == NULL)
+        return 1;
+
+    /* Glyphs are opaque, the key only has to differ from both colors */
+    while (key == fg || key == bg)
+        key++;
+
+    for (int c = 0; c < FONT_CHARS; c++)
+    {
+        uint8_t *pixels = font->pixels + c * glyph_size;
+
+        surface_init(&glyph, pixels, FONT_WIDTH, FONT_HEIGHT,
+            FONT_WIDTH * bytes, surface->renderer->bits_per_pixel);
+        blit_clear(&glyph, bg);
+
+        for (int j = 0; j < 7; j++)
+            for (int i = 0; i < 5; i++)
+                if (font_rows[c][j] & (0x10 >> i))
+                    blit_fill(&glyph, i, j, 1, 1, fg);
+
+        font->glyphs[c].pixels = pixels;
+        font->glyphs[c].width = FONT_WIDTH;
+        font->glyphs[c].height = FONT_HEIGHT;
+        font->glyphs[c].key = key;
+    }
+
+    return 0;
+}
+
+/* Draws 'text' with its top left corner at (x, y), characters without a
+   glyph are drawn as blanks
+
+   Returns the width of the text in pixels.
+*/
+int font_draw(const Font *font, Surface *surface, int x, int y,
+    const char *text)
+{
+    int x0 = x;
+    int c;
+
+    for (; *text; text++, x += FONT_WIDTH)
+    {
+        c = toupper((unsigned char)*text) - FONT_FIRST;
+        if (c < 0 || c >= FONT_CHARS)
+            c = 0;
+        blit_sprite(surface, x, y, &font->glyphs[c]);
+    }
+
+    return x - x0;
+}
+
+void font_free(Font *font)
+{
+    free(font->pixels);
+    font->pixels = NULL;
+}
@@ -0,0 +1,28 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include "blit.h"
+
+/* Glyphs are 5x7 pixels drawn in a 6x8 cell, the spacing in background */
+#define FONT_WIDTH  6
+#define FONT_HEIGHT 8
+
+/* Characters ' ' to 'Z', lower case is drawn as upper case */
+#define FONT_FIRST ' '
+#define FONT_CHARS ('Z' - ' ' + 1)
+
+typedef struct Font Font;
+
+/* Glyphs rasterized once in the pixel format of one surface */
+struct Font
+{
+    Sprite glyphs[FONT_CHARS];
+    uint8_t *pixels;
+};
+
+int font_init(Font *font, const Surface *surface, pixel_t fg, pixel_t bg);
+int font_draw(const Font *font, Surface *surface, int x, int y,
+    const char *text);
+void font_free(Font *font);
+
+#endif /* FONT_H */
@@ -5,42 +5,103 @@
 
 #include <inttypes.h>
 #include <stdlib.h>
-#include <linux/fb.h>
-#include <sys/mman.h>
-#include <sys/ioctl.h>
-#include <sys/time.h>
+#include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 #include <signal.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "damage.h"
+#include "ticker.h"
+#include "snake.h"
+#include "blit.h"
+#include "display.h"
+#include "rng.h"
+#include "replay.h"
+#include "hud.h"
+#include "latency.h"
+#include "triple.h"
+#include "autopilot.h"
+#include "engine.h"
+#include "input.h"
+#include "sound.h"
 
 /* Extracts bit 'n' of 's' */
 #define BIT(s, n) (((s) >> (n)) & 1U)
 
-FILE *gamepad = NULL;
+/* Turns queued between ticks, must be a power of two */
+#define DIRECTION_QUEUE_SIZE 4
+#define DIRECTION_QUEUE_MASK (DIRECTION_QUEUE_SIZE - 1)
 
-/* Screen dimensions */
-#define WIDTH 320
-#define HEIGHT 240
-int window_w = WIDTH;
-int window_h = HEIGHT;
+/* Read times kept of applied turns, must be a power of two */
+#define TURN_LOG_SIZE 64
+#define TURN_LOG_MASK (TURN_LOG_SIZE - 1)
 
-typedef uint16_t pixel_t;
+int epoll_fd = -1;
 
-pixel_t *screen;
-struct fb_copyarea screen_region;
-int screen_fd;
+typedef struct Turn Turn;
 
-/* Key mapping according to bit possition */
-enum { SW1, SW2, SW3, SW4, SW5, SW6, SW7, SW8 };
-
-/* Snake movement directions */
-enum { UP, DOWN, RIGHT, LEFT };
+/* Turn and the time its button press was read */
+struct Turn
+{
+    int direction;
+    double time;
+};
 
 int current_direction = RIGHT;
-int next_direction = RIGHT;
+
+/* Turns not yet applied, one is taken per tick */
+Turn direction_queue[DIRECTION_QUEUE_SIZE];
+unsigned int queue_head = 0;
+unsigned int queue_tail = 0;
+
+/* Read times of applied turns by the count of turns applied before them,
+   turns up to 'turns_applied' are displayed from 'turns_shown' on */
+double turn_log[TURN_LOG_SIZE];
+uint32_t turns_applied = 0;
+uint32_t turns_shown = 0;
+
+/* Latency windows, 'display_latency' is filled on the render thread when
+   there is one so both are only touched under 'latency_lock' */
+Latency tick_latency = { "input to tick" };
+Latency display_latency = { "input to display" };
+pthread_mutex_t latency_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Simulation ticks since start, turns are recorded and replayed by tick */
+uint32_t tick = 0;
+int recording = 0;
+int replaying = 0;
+
+/* Cleared to skip drawing altogether, for simulation only replays */
+int render = 1;
+
+/* Set to overlay frame statistics on the board */
+int hud = 0;
+
+/* Set to let the autopilot steer instead of the input backend */
+int autopilot = 0;
+
+/* Games finished and the sum of their final lengths */
+long games = 0;
+long total_score = 0;
+
+/* Frames presented and ticks simulated, the run stops after 'max_frames'
+   frames unless it is 0 */
+int frames = 0;
+long total_ticks = 0;
+int max_frames = 0;
+
+/* Cleared by SIGINT and SIGTERM and at the end of a replay */
+volatile sig_atomic_t running = 1;
+
+/* Set by SIGUSR1 to print the latency histograms */
+volatile sig_atomic_t print_latency = 0;
 
 
 /*------------------------------------------------------------------------------
@@ -50,6 +111,16 @@ int next_direction = RIGHT;
  *----------------------------------------------------------------------------*/
 
 
+void stop(int signo)
+{
+    running = 0;
+}
+
+void request_latency(int signo)
+{
+    print_latency = 1;
+}
+
 void print_bits(int value)
 {
     int i = 0;
@@ -60,127 +131,208 @@ void print_bits(int value)
 
 double walltime(void)
 {
-    static struct timeval t;
-    gettimeofday(&t, NULL);
-    return (double)t.tv_sec + (double)t.tv_usec * 1.0e-6;
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1.0e-9;
 }
 
 
 /*------------------------------------------------------------------------------
  *
- * SIGIO handler
+ * Input
  *
  *----------------------------------------------------------------------------*/
 
 
-void interrupt_handler(int signo)
+/* Returns the direction opposite to 'direction' */
+int opposite(int direction)
 {
-    int8_t key_pressed = 0x00;
-
-    read(fileno(gamepad), &key_pressed, 1);
-
-    key_pressed = ~key_pressed;
-
-    if (BIT(key_pressed, SW1))
-        next_direction = LEFT;
-    if (BIT(key_pressed, SW3))
-        next_direction = RIGHT;
-    if (BIT(key_pressed, SW2))
-        next_direction = UP;
-    if (BIT(key_pressed, SW4))
-        next_direction = DOWN;
-
-    /* NOP when direction is opposite to current direction */
-    switch (next_direction)
+    switch (direction)
     {
     case UP:
-        if (current_direction == DOWN)
-            return;
-        break;
+        return DOWN;
     case DOWN:
-        if (current_direction == UP)
-            return;
-        break;
+        return UP;
     case RIGHT:
-        if (current_direction == LEFT)
-            return;
-        break;
-    case LEFT:
-        if (current_direction == RIGHT)
-            return;
-        break;
+        return LEFT;
+    default:
+        return RIGHT;
+    }
+}
+
+/* Queues a turn read at 'time', dropping repeats and reversals of the last
+   queued one */
+void queue_direction(int direction, double time)
+{
+    Turn *turn;
+    int last = current_direction;
+
+    if (queue_head != queue_tail)
+    {
+        turn = &direction_queue[(queue_head - 1) & DIRECTION_QUEUE_MASK];
+        last = turn->direction;
     }
 
-    current_direction = next_direction;
+    if (direction == last || direction == opposite(last))
+        return;
+    if (queue_head - queue_tail == DIRECTION_QUEUE_SIZE)
+        return;
+
+    turn = &direction_queue[queue_head++ & DIRECTION_QUEUE_MASK];
+    turn->direction = direction;
+    turn->time = time;
 }
 
+/* Applies the next queued turn, called once per tick */
+void next_direction(void)
+{
+    Turn *turn;
+
+    if (queue_head == queue_tail)
+        return;
+
+    turn = &direction_queue[queue_tail++ & DIRECTION_QUEUE_MASK];
+    current_direction = turn->direction;
+
+    pthread_mutex_lock(&latency_lock);
+    latency_add(&tick_latency, walltime() - turn->time);
+    pthread_mutex_unlock(&latency_lock);
+    turn_log[turns_applied & TURN_LOG_MASK] = turn->time;
+    turns_applied++;
+}
+
+/* Accounts the turns up to 'applied' as displayed at 'time', turns that fell
+   out of the log are skipped */
+void turns_displayed(uint32_t applied, double time)
+{
+    if (applied - turns_shown > TURN_LOG_SIZE)
+        turns_shown = applied - TURN_LOG_SIZE;
+
+    if (turns_shown == applied)
+        return;
+
+    pthread_mutex_lock(&latency_lock);
+    for (; turns_shown != applied; turns_shown++)
+        latency_add(&display_latency,
+            time - turn_log[turns_shown & TURN_LOG_MASK]);
+    pthread_mutex_unlock(&latency_lock);
+}
+
+/* Prints both latency windows */
+void print_latencies(void)
+{
+    pthread_mutex_lock(&latency_lock);
+    latency_print(&tick_latency);
+    latency_print(&display_latency);
+    pthread_mutex_unlock(&latency_lock);
+}
+
+
 
 /*------------------------------------------------------------------------------
  *
- * Driver setup
+ * Event loop
  *
  *----------------------------------------------------------------------------*/
 
 
-int init_gamepad()
+/* Queues the pending input, and stops reading input that has ended */
+void read_input(void)
 {
-    gamepad = fopen("/dev/gamepad", "rb+");
+    if (input_fd() == -1 || !input_read(queue_direction, walltime()))
+        return;
 
-    int fd = fileno(gamepad);
+    if (!input_polled())
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, input_fd(), NULL);
+    input_close();
+}
 
-    if (!gamepad)
-    {
-        printf("Failed opening gamedpad driver\n");
-        return 1;
-    }
+/* Adds 'fd' to the descriptors the event loop waits on */
+int watch_fd(int fd)
+{
+    struct epoll_event event;
 
-    /* Set interrupt handler for SIGIO */
-    if (signal(SIGIO, &interrupt_handler) == SIG_ERR)
-    {
-        printf("Failed binding function\n");
-        return 1;
-    }
-    /* Set ownership of file descriptor to this process */
-    if (fcntl(fd, F_SETOWN, getpid()) == -1)
-    {
-        printf("Failed setting owner\n");
-        return 1;
-    }
-    /* Register this process to recieve SIGIO from driver */
-    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | FASYNC) == -1)
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1)
     {
-        printf("Failed setting FASYNC flag\n");
+        printf("Failed to watch descriptor\n");
         return 1;
     }
 
     return 0;
 }
 
-int init_graphics()
+int init_events(void)
 {
-    screen_fd = open("/dev/fb0", O_RDWR);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
 
-    if (screen_fd == -1)
+    if (epoll_fd == -1)
     {
-        printf("Failed to open display driver\n");
+        printf("Failed to create event loop\n");
         return 1;
     }
 
-    screen_region.dx = 0;
-    screen_region.dy = 0;
-    screen_region.width = window_w;
-    screen_region.height = window_h;
+    return 0;
+}
+
+/* Starts the input backend 'name' on 'path' and adds it to the event loop
 
-    screen = (uint16_t*)mmap(NULL, window_w * window_h * sizeof(pixel_t),
-        PROT_READ | PROT_WRITE, MAP_SHARED, screen_fd, 0);
+   Without a backend asked for the gamepad is tried, and the game runs
+   without input if there is none.
+*/
+int init_input(const char *name, const char *path)
+{
+    if (input_init(name ? name : "gamepad", path))
+        return name != NULL;
+
+    if (input_polled())
+        return 0;
+
+    return watch_fd(input_fd());
+}
+
+/* Handles input until the tick timer fires
 
-    if (screen == MAP_FAILED)
+   Returns the number of ticks that elapsed, or -1 on error. Without a timer
+   ('fast' mode) pending input is handled and a single tick is returned.
+*/
+int wait_ticks(int fast)
+{
+    struct epoll_event events[2];
+    int ticks = 0;
+    int n;
+
+    while (ticks == 0)
     {
-        printf("Failed to map pixel array to framebuffer\n");
-        return 1;
+        n = epoll_wait(epoll_fd, events, 2, fast ? 0 : -1);
+
+        if (n == -1)
+        {
+            if (errno == EINTR)
+            {
+                if (!running)
+                    return 0;
+                continue;
+            }
+            printf("Failed waiting for events\n");
+            return -1;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            if (events[i].data.fd == input_fd())
+                read_input();
+            else
+                ticks = ticker_wait();
+        }
+
+        if (fast)
+            return 1;
     }
 
-    return 0;
+    return ticks;
 }
 
 
@@ -191,177 +343,852 @@ int init_graphics()
  *----------------------------------------------------------------------------*/
 
 
-#define COLOR_BACKGROUND 0xffff
-#define COLOR_APPLE 0xf9a6
-#define COLOR_SNAKE 0x4208
+#define RGB_BACKGROUND 0xffffff
+#define RGB_APPLE 0xff3431
+#define RGB_SNAKE 0x424142
+#define RGB_HUD_TEXT 0xffffff
+#define RGB_HUD_BACKGROUND 0x000000
+
+/* Colors in the pixel format of the display */
+pixel_t color_background;
+pixel_t color_apple;
+pixel_t color_snake;
+
+/* Music looped while playing and the effects of eating and dying */
+const Note music_notes[] = {
+    { 262, 200 }, { 330, 200 }, { 392, 200 }, { 523, 200 },
+    { 392, 200 }, { 330, 200 }, { 0, 400 },
+    { 220, 200 }, { 262, 200 }, { 330, 200 }, { 440, 200 },
+    { 330, 200 }, { 262, 200 }, { 0, 400 }
+};
+const Note eat_notes[] = { { 880, 40 }, { 1175, 60 } };
+const Note die_notes[] = { { 400, 100 }, { 300, 100 }, { 200, 100 },
+    { 100, 200 } };
+
+const Song music_song = { music_notes, 14, WAVE_SQUARE, 1 };
+const Song eat_song = { eat_notes, 2, WAVE_SQUARE, 0 };
+const Song die_song = { die_notes, 4, WAVE_SAW, 0 };
+
+/* Smallest square drawn, boards that would need smaller squares are shown
+   through a camera following the head */
+#define MIN_SQUARE_SIZE 4
+
+/* Board placement on the screen, the 'view_w' x 'view_h' cells from
+   (camera_x, camera_y) on are drawn centered with square cells */
+int square_size;
+int board_x;
+int board_y;
+int view_w;
+int view_h;
+int camera_x = 0;
+int camera_y = 0;
+
+/* Simulation tick period, shortened for every segment the snake grows */
+#define TICK_PERIOD_NS   (150 * 1000000L)
+#define TICK_MIN_NS      (50 * 1000000L)
+#define TICK_SPEEDUP_NS  (2 * 1000000L)
+
+/* Ticks simulated per wakeup after an overrun, any further ones are dropped */
+#define MAX_CATCHUP_TICKS 3
+
+/* Game state */
+Snake snake;
+cell_t apple;
+uint32_t rng;
+
+/* Search state of the autopilot and the path it is following */
+Autopilot pilot;
+Plan plan;
+
+void init_layout(void);
+void draw_square(int x, int y, int size, pixel_t color);
+void paint_view(int x, int y, pixel_t color);
+void paint_cell(cell_t cell, pixel_t color);
+void draw_cell(cell_t cell, pixel_t color);
+void clear_board(void);
+int follow(int camera, int head, int view, int size);
+int follow_head(void);
+void redraw_view(void);
+void init_game(void);
+void end_game(void);
+int steer(void);
+int update_game(void);
+long tick_period(int length);
+void finish_frame(double frame_start, double flush_start, uint32_t turns,
+    int length);
+void present_frame(double frame_start);
+void report_rates(int frames, long ticks, double seconds);
+void usage(const char *name);
+
+/* Fits the board, or as much of it as MIN_SQUARE_SIZE allows, to the screen
+   and converts the colors to its format */
+void init_layout(void)
+{
+    square_size = screen.width / snake.width;
+    if (screen.height / snake.height < square_size)
+        square_size = screen.height / snake.height;
+    if (square_size < MIN_SQUARE_SIZE)
+        square_size = MIN_SQUARE_SIZE;
+
+    view_w = screen.width / square_size;
+    if (view_w > snake.width)
+        view_w = snake.width;
+    view_h = screen.height / square_size;
+    if (view_h > snake.height)
+        view_h = snake.height;
+
+    board_x = (screen.width - square_size * view_w) / 2;
+    board_y = (screen.height - square_size * view_h) / 2;
+
+    color_background = format_color(&screen_format, RGB_BACKGROUND);
+    color_apple = format_color(&screen_format, RGB_APPLE);
+    color_snake = format_color(&screen_format, RGB_SNAKE);
+}
 
-#define SQUARE_SIZE (int)(10)
-#define N_SQUARES (int)(WIDTH * HEIGHT / (SQUARE_SIZE * SQUARE_SIZE))
-#define N_SQUARES_X (int)(WIDTH / SQUARE_SIZE)
-#define N_SQUARES_Y (int)(HEIGHT / SQUARE_SIZE)
+void draw_square(int x, int y, int size, pixel_t color)
+{
+    blit_fill(&screen, x, y, size, size, color);
+    damage_add(x, y, size, size);
+    if (hud)
+        hud_touch(x, y, size, size);
+}
 
-typedef struct Snake Snake;
-typedef struct Square Square;
+/* Paints the square at (x, y) of the view */
+void paint_view(int x, int y, pixel_t color)
+{
+    draw_square(board_x + x * square_size, board_y + y * square_size,
+        square_size, color);
+}
 
-struct Square
+/* Paints 'cell' if the camera shows it */
+void paint_cell(cell_t cell, pixel_t color)
 {
-    int x;
-    int y;
-} apple;
+    int x = CELL_X(&snake, cell) - camera_x;
+    int y = CELL_Y(&snake, cell) - camera_y;
+
+    if (x >= 0 && x < view_w && y >= 0 && y < view_h)
+        paint_view(x, y, color);
+}
 
-struct Snake
+/* Draws a cell changed by the game, unless a render thread draws instead */
+void draw_cell(cell_t cell, pixel_t color)
 {
-    int x[N_SQUARES];
-    int y[N_SQUARES];
-    int length;
-} snake;
+    if (render)
+        paint_cell(cell, color);
+}
 
-int apple_collision(void);
-int snake_collision(void);
-void draw_square(int x, int y, int size, pixel_t color);
-void init_snake(int x, int y, int length);
-void print_board_info(void);
-void init_game(void);
-void update_direction(void);
-void update_snake(void);
+void clear_board(void)
+{
+    blit_clear(&screen, color_background);
+    damage_add_all();
+    if (hud)
+        hud_touch(0, 0, screen.width, screen.height);
+}
+
+/* Returns where a camera at 'camera' along an axis of 'size' cells, showing
+   'view' of them, moves to keep 'head' out of the outer quarters */
+int follow(int camera, int head, int view, int size)
+{
+    if (head - camera < view / 4 || head - camera >= view - view / 4)
+        camera = head - view / 2;
+
+    if (camera > size - view)
+        camera = size - view;
+    if (camera < 0)
+        camera = 0;
 
-void init_snake(int x, int y, int length)
+    return camera;
+}
+
+/* Moves the camera along with the head
+
+   Returns 1 if it moved, the whole view must then be redrawn.
+*/
+int follow_head(void)
+{
+    cell_t head = snake_head(&snake);
+    int x = follow(camera_x, CELL_X(&snake, head), view_w, snake.width);
+    int y = follow(camera_y, CELL_Y(&snake, head), view_h, snake.height);
+
+    if (x == camera_x && y == camera_y)
+        return 0;
+
+    camera_x = x;
+    camera_y = y;
+    return 1;
+}
+
+/* Redraws every cell the camera shows, the cost depends on the screen size
+   rather than on the board or the snake */
+void redraw_view(void)
+{
+    clear_board();
+
+    for (int y = 0; y < view_h; y++)
+        for (int x = 0; x < view_w; x++)
+            if (snake_collision(&snake,
+                CELL(&snake, camera_x + x, camera_y + y)))
+                paint_view(x, y, color_snake);
+
+    paint_cell(apple, color_apple);
+}
+
+void init_game(void)
 {
     current_direction = RIGHT;
-    next_direction    = RIGHT;
+    queue_head = queue_tail = 0;
+    plan.step = 0;
 
-    for (int i = 0; i < length; i++)
-    {
-        snake.x[i] = x - i * SQUARE_SIZE;
-        snake.y[i] = y;
-    }
-    snake.length = length;
+    engine_reset(&snake, &apple, &rng);
+    follow_head();
+
+    /* Init background */
+    if (render)
+        clear_board();
+
+    for (int i = 0; i < snake.length; i++)
+        draw_cell(snake_segment(&snake, i), color_snake);
+    draw_cell(apple, color_apple);
 }
 
-void update_snake(void)
+/* Scores the game that just ended */
+void end_game(void)
 {
-    int *x = snake.x;
-    int *y = snake.y;
+    games++;
+    total_score += snake.length;
+}
 
-    int x_prev[snake.length];
-    int y_prev[snake.length];
+/* Takes the turn for this tick from the input, or from the log when
+   replaying, and records it when recording
 
-    memcpy(x_prev, x, snake.length * sizeof(int));
-    memcpy(y_prev, y, snake.length * sizeof(int));
+   Returns 1 once a replayed session is over.
+*/
+int steer(void)
+{
+    int direction = current_direction;
+    int turn;
 
-    for (int i = 1; i <= snake.length; i++)
+    if (replaying)
     {
-        x[i] = x_prev[i - 1];
-        y[i] = y_prev[i - 1];
+        turn = replay_read(tick);
+        if (turn == REPLAY_END)
+            return 1;
+        if (turn != REPLAY_NONE)
+            current_direction = turn;
+        return 0;
     }
 
-    switch (current_direction)
+    if (autopilot)
+        current_direction = autopilot_direction(&pilot, &plan, &snake, apple,
+            current_direction);
+    else
     {
-    case UP:
-        y[0] -= SQUARE_SIZE;
-        break;
-    case DOWN:
-        y[0] += SQUARE_SIZE;
-        break;
-    case RIGHT:
-        x[0] += SQUARE_SIZE;
+        if (input_polled())
+            read_input();
+        next_direction();
+    }
+
+    if (recording && current_direction != direction)
+        replay_write(tick, current_direction);
+
+    return 0;
+}
+
+/* Advances the game by one simulation tick and draws the cells it changed
+
+   Returns 1 once a replayed session is over.
+*/
+int update_game(void)
+{
+    cell_t tail;
+
+    if (steer())
+        return 1;
+    tick++;
+
+    switch (engine_step(&snake, &apple, &rng, current_direction, &tail))
+    {
+    case ENGINE_MOVED:
+        draw_cell(tail, color_background);
+        draw_cell(snake_head(&snake), color_snake);
         break;
-    case LEFT:
-        x[0] -= SQUARE_SIZE;
+    case ENGINE_ATE:
+        draw_cell(snake_head(&snake), color_snake);
+        sound_play(SOUND_EFFECT, &eat_song);
         break;
+    default:
+        sound_play(SOUND_EFFECT, &die_song);
+        end_game();
+        init_game();
+        return 0;
     }
 
-    for (int i = 0; i < snake.length; i++)
+    draw_cell(apple, color_apple);
+
+    if (follow_head() && render)
+        redraw_view();
+
+    return 0;
+}
+
+/* Returns the tick period for a snake of 'length' segments */
+long tick_period(int length)
+{
+    long period = TICK_PERIOD_NS - (long)length * TICK_SPEEDUP_NS;
+
+    return period < TICK_MIN_NS ? TICK_MIN_NS : period;
+}
+
+/* Accounts a frame drawn from 'frame_start' and flushed from 'flush_start'
+   on, showing the first 'turns' turns and a snake of 'length' */
+void finish_frame(double frame_start, double flush_start, uint32_t turns,
+    int length)
+{
+    double frame_end = walltime();
+
+    frames++;
+    turns_displayed(turns, frame_end);
+
+    if (hud)
+        hud_frame(frame_end, frame_end - frame_start,
+            frame_end - flush_start, length);
+}
+
+/* Draws and flushes the frame of the serial loop, the game has already
+   drawn the changed cells */
+void present_frame(double frame_start)
+{
+    double flush_start;
+
+    if (hud && render)
+        hud_draw();
+
+    flush_start = walltime();
+    if (render)
+        display_present();
+
+    finish_frame(frame_start, flush_start, turns_applied, snake.length);
+}
+
+
+void report_rates(int frames, long ticks, double seconds)
+{
+    printf("%d frames, %ld ticks in %.3f s: %.1f frames/s, %.1f ticks/s\n",
+        frames, ticks, seconds, frames / seconds, ticks / seconds);
+
+    if (games > 0)
+        printf("%ld games: %.1f games/s, average score %.1f\n", games,
+            games / seconds, (double)total_score / games);
+}
+
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Render thread
+ *
+ *----------------------------------------------------------------------------*/
+
+
+typedef struct Snapshot Snapshot;
+
+/* View state handed from the simulation to the render thread, 'visible'
+   holds one bit per cell the camera shows, row by row */
+struct Snapshot
+{
+    uint32_t *visible;
+    int camera_x;
+    int camera_y;
+    cell_t apple;
+    int length;
+    uint32_t turns;
+};
+
+Snapshot snapshots[3];
+TripleBuffer snapshot_buffer;
+
+/* Words of a 'visible' bitmap, and the bitmaps of the snapshots followed
+   by the one the render thread last drew */
+int view_words;
+uint32_t *visible[4];
+
+/* Wakes the render thread when a snapshot is published */
+int wake_fd = -1;
+
+void publish_snapshot(void);
+int apple_in_view(const Snapshot *snapshot);
+void draw_snapshot(const Snapshot *snapshot);
+void draw_changes(const Snapshot *from, const Snapshot *to);
+void *render_main(void *arg);
+
+/* Copies the cells the camera shows into the back snapshot and publishes
+   it, the cost depends on the screen size rather than on the board */
+void publish_snapshot(void)
+{
+    Snapshot *next = &snapshots[snapshot_buffer.back];
+    int i = 0;
+
+    memset(next->visible, 0, view_words * sizeof(uint32_t));
+    for (int y = 0; y < view_h; y++)
+        for (int x = 0; x < view_w; x++, i++)
+            if (snake_collision(&snake,
+                CELL(&snake, camera_x + x, camera_y + y)))
+                next->visible[i / 32] |= 1U << (i % 32);
+
+    next->camera_x = camera_x;
+    next->camera_y = camera_y;
+    next->apple = apple;
+    next->length = snake.length;
+    next->turns = turns_applied;
+
+    triple_publish(&snapshot_buffer);
+    eventfd_write(wake_fd, 1);
+}
+
+/* Returns the view index of the apple in 'snapshot', or -1 if not shown */
+int apple_in_view(const Snapshot *snapshot)
+{
+    int x = CELL_X(&snake, snapshot->apple) - snapshot->camera_x;
+    int y = CELL_Y(&snake, snapshot->apple) - snapshot->camera_y;
+
+    if (x < 0 || x >= view_w || y < 0 || y >= view_h)
+        return -1;
+
+    return y * view_w + x;
+}
+
+/* Draws the whole view of 'snapshot' */
+void draw_snapshot(const Snapshot *snapshot)
+{
+    int apple_index = apple_in_view(snapshot);
+
+    clear_board();
+
+    for (int i = 0; i < view_w * view_h; i++)
+        if (BIT(snapshot->visible[i / 32], i % 32))
+            paint_view(i % view_w, i / view_w, color_snake);
+
+    if (apple_index >= 0)
+        paint_view(apple_index % view_w, apple_index / view_w, color_apple);
+}
+
+/* Paints the cells that differ between the views 'from' and 'to', both
+   taken with the same camera */
+void draw_changes(const Snapshot *from, const Snapshot *to)
+{
+    int old_apple = apple_in_view(from);
+    int new_apple = apple_in_view(to);
+    uint32_t changed;
+    int i;
+
+    for (int w = 0; w < view_words; w++)
     {
-        if (x[i] < 0)
-            x[i] = WIDTH - SQUARE_SIZE;
-        else if (x[i] >= WIDTH)
-            x[i] = 0;
-        else if (y[i] < 0)
-            y[i] = HEIGHT - SQUARE_SIZE;
-        else if (y[i] >= HEIGHT)
-            y[i] = 0;
+        for (changed = from->visible[w] ^ to->visible[w]; changed;
+            changed &= changed - 1)
+        {
+            i = w * 32 + __builtin_ctz(changed);
+            paint_view(i % view_w, i / view_w, BIT(to->visible[w], i % 32) ?
+                color_snake : color_background);
+        }
+    }
+
+    if (old_apple != new_apple)
+    {
+        if (old_apple >= 0 && !BIT(to->visible[old_apple / 32], old_apple % 32))
+            paint_view(old_apple % view_w, old_apple / view_w,
+                color_background);
+        if (new_apple >= 0)
+            paint_view(new_apple % view_w, new_apple / view_w, color_apple);
     }
 }
 
-void draw_square(int x, int y, int size, pixel_t color)
+/* Draws and flushes the latest snapshot whenever one is published, until
+   the game stops */
+void *render_main(void *arg)
 {
-    for (int i = x; i < x + size; i++)
-        for (int j = y; j < y + size; j++)
-            screen[window_w * j + i] = color;
+    Snapshot shown;
+    const Snapshot *next;
+    double frame_start;
+    double flush_start;
+    uint64_t value;
+    int first = 1;
+    int stopping;
+
+    shown.visible = arg;
+
+    do
+    {
+        eventfd_read(wake_fd, &value);
+        stopping = !__atomic_load_n(&running, __ATOMIC_ACQUIRE);
+
+        if (!triple_take(&snapshot_buffer))
+            continue;
+
+        next = &snapshots[snapshot_buffer.front];
+        frame_start = walltime();
+
+        if (first || next->camera_x != shown.camera_x ||
+            next->camera_y != shown.camera_y)
+            draw_snapshot(next);
+        else
+            draw_changes(&shown, next);
+        first = 0;
+
+        memcpy(shown.visible, next->visible, view_words * sizeof(uint32_t));
+        shown.camera_x = next->camera_x;
+        shown.camera_y = next->camera_y;
+        shown.apple = next->apple;
+
+        if (hud)
+            hud_draw();
+
+        flush_start = walltime();
+        display_present();
+        finish_frame(frame_start, flush_start, next->turns, next->length);
+
+        if (max_frames != 0 && frames >= max_frames)
+            __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+    }
+    while (!stopping);
+
+    return NULL;
 }
 
-int snake_collision(void)
+/* Starts the render thread, which takes over all drawing from the game
+
+   Returns 1 if it could not be started.
+*/
+int start_render_thread(pthread_t *thread)
 {
-    for (int i = 3; i < snake.length; i++)
-        if ((snake.x[0] == snake.x[i]) && (snake.y[0] == snake.y[i]))
+    sigset_t all;
+    sigset_t old;
+    int error;
+
+    wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (wake_fd == -1)
+    {
+        printf("Failed to create render wakeup\n");
+        return 1;
+    }
+
+    /* Three snapshots in the triple buffer and the view last drawn */
+    view_words = (view_w * view_h + 31) / 32;
+    for (int i = 0; i < 4; i++)
+    {
+        visible[i] = calloc(view_words, sizeof(uint32_t));
+        if (visible[i] == NULL)
+        {
+            printf("Failed to allocate render snapshots\n");
             return 1;
+        }
+        if (i < 3)
+            snapshots[i].visible = visible[i];
+    }
+
+    triple_init(&snapshot_buffer);
+    render = 0;
+
+    /* Signals are left to the simulation thread */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    error = pthread_create(thread, NULL, render_main, visible[3]);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (error)
+    {
+        printf("Failed to start render thread\n");
+        return 1;
+    }
+
     return 0;
 }
 
-int apple_collision(void)
+void stop_render_thread(pthread_t thread)
 {
-    return (apple.x == snake.x[0]) && (apple.y == snake.y[0]);
+    __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+    eventfd_write(wake_fd, 1);
+    pthread_join(thread, NULL);
+    close(wake_fd);
+
+    for (int i = 0; i < 4; i++)
+        free(visible[i]);
 }
 
-void init_game(void)
+void usage(const char *name)
 {
-    /* Init snake */
-    init_snake(WIDTH / 2, HEIGHT / 2, 3);
-    for (int i = 0; i < snake.length; i++)
-        draw_square(snake.x[i], snake.y[i], SQUARE_SIZE, COLOR_SNAKE);
-
-    /* Init background */
-    memset(screen, COLOR_BACKGROUND, window_w * window_h * sizeof(pixel_t));
-
-    /* Init apple */
-    apple.x = (rand() % N_SQUARES_X) * SQUARE_SIZE;
-    apple.y = (rand() % N_SQUARES_Y) * SQUARE_SIZE;
-    draw_square(apple.x, apple.y, SQUARE_SIZE, COLOR_APPLE);
+    printf("Usage: %s [-d efm32|fbdev|headless] [-b] [-f] [-q] [-H] [-P] [-A]\n"
+        "          [-n frames] [-W WIDTHxHEIGHT]\n"
+        "          [-s WIDTHxHEIGHT] [-p bpp] [-o dir] [-c file] [-g file]\n"
+        "          [-S seed] [-r file | -R file]\n"
+        "          [-i gamepad|evdev|terminal|script] [-I path]\n"
+        "          [-a null|wav|alsa] [-w file]\n"
+        "\n"
+        "  -d  display backend, efm32 by default\n"
+        "  -b  draw into a back buffer in RAM\n"
+        "  -f  run as fast as possible instead of at the tick rate\n"
+        "  -q  skip drawing, only simulate\n"
+        "  -A  let the autopilot play\n"
+        "  -P  draw and flush on a separate thread on multi-core hosts\n"
+        "  -H  show frame rate, frame and flush times in ms and length\n"
+        "  -n  stop after this many frames\n"
+        "  -W  board size in cells, 32x24 by default\n"
+        "  -s  headless screen size, 320x240 by default\n"
+        "  -p  headless bits per pixel, 16 or 32\n"
+        "  -o  headless, dump every frame as PPM into this directory\n"
+        "  -c  headless, write frame checksums to this file\n"
+        "  -g  headless, compare frame checksums with this file\n"
+        "  -S  seed the apple placement\n"
+        "  -r  record the session to this file\n"
+        "  -R  replay the session in this file\n"
+        "  -i  input backend, gamepad by default\n"
+        "  -I  input device or script, '-' for standard input\n"
+        "  -a  play sound into this sink, none by default\n"
+        "  -w  file the wav sink writes, game.wav by default\n", name);
 }
 
 int main(int argc, char *argv[])
 {
-    init_graphics();
-    init_gamepad();
+    DisplayOptions options = { 0, 320, 240, 16, NULL, NULL, NULL };
+    const char *backend = "efm32";
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    const char *input = NULL;
+    const char *input_path = NULL;
+    const char *sink = NULL;
+    const char *wav_path = NULL;
+    uint32_t seed = time(NULL) ^ getpid();
+    uint32_t width = N_SQUARES_X;
+    uint32_t height = N_SQUARES_Y;
+    pthread_t render_thread;
+    int pipelined = 0;
+    int fast = 0;
+    double start;
+    double frame_start;
+    int status;
+    int length;
+    int ticks;
+    int done;
+    int opt;
 
-    printf("Running game...\n");
+    while ((opt = getopt(argc, argv, "d:bfqHPAn:W:s:p:o:c:g:S:r:R:i:I:a:w:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            backend = optarg;
+            break;
+        case 'b':
+            options.double_buffer = 1;
+            break;
+        case 'f':
+            fast = 1;
+            break;
+        case 'q':
+            render = 0;
+            break;
+        case 'H':
+            hud = 1;
+            break;
+        case 'P':
+            pipelined = 1;
+            break;
+        case 'A':
+            autopilot = 1;
+            break;
+        case 'n':
+            max_frames = atoi(optarg);
+            break;
+        case 'W':
+            if (sscanf(optarg, "%ux%u", &width, &height) != 2)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 's':
+            if (sscanf(optarg, "%dx%d", &options.width, &options.height) != 2)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'p':
+            options.bits_per_pixel = atoi(optarg);
+            break;
+        case 'o':
+            options.dump_dir = optarg;
+            break;
+        case 'c':
+            options.checksum_path = optarg;
+            break;
+        case 'g':
+            options.golden_path = optarg;
+            break;
+        case 'S':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            record_path = optarg;
+            break;
+        case 'R':
+            replay_path = optarg;
+            break;
+        case 'i':
+            input = optarg;
+            break;
+        case 'I':
+            input_path = optarg;
+            break;
+        case 'a':
+            sink = optarg;
+            break;
+        case 'w':
+            wav_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
 
-    init_game();
+    if (replay_path != NULL)
+    {
+        if (replay_open(replay_path, &seed, &width, &height))
+            return 1;
+        replaying = 1;
+    }
+    else if (record_path != NULL)
+    {
+        if (replay_record(record_path, seed, width, height))
+            return 1;
+        recording = 1;
+    }
 
-    while (1)
+    if (snake_create(&snake, width, height))
     {
-        /* Draw snake */
-        draw_square(snake.x[snake.length - 1], snake.y[snake.length - 1],
-            SQUARE_SIZE, COLOR_BACKGROUND);
-        update_snake();
-        draw_square(snake.x[0], snake.y[0], SQUARE_SIZE, COLOR_SNAKE);
+        printf("Failed to create a %ux%u board\n", width, height);
+        return 1;
+    }
 
-        if (apple_collision())
+    if (display_init(backend, &options) || init_events())
+        return 1;
+    init_layout();
+    if (hud && hud_init(&screen, 2, 2,
+        format_color(&screen_format, RGB_HUD_TEXT),
+        format_color(&screen_format, RGB_HUD_BACKGROUND)))
+        return 1;
+    if (autopilot)
+    {
+        if (autopilot_create(&pilot, width, height) ||
+            autopilot_plan_create(&plan, width, height))
         {
-            /* Extend snake */
-            snake.x[snake.length] = snake.x[snake.length - 1];
-            snake.y[snake.length] = snake.y[snake.length - 1];
-            snake.length++;
-
-            /* Seed apple */
-            apple.x = (rand() % N_SQUARES_X) * SQUARE_SIZE;
-            apple.y = (rand() % N_SQUARES_Y) * SQUARE_SIZE;
+            printf("Failed to allocate autopilot\n");
+            return 1;
         }
-        else if (snake_collision())
+    }
+    else if (!replaying && init_input(input, input_path))
+        return 1;
+    if (sink != NULL)
+    {
+        if (sound_init(sink, wav_path))
+            return 1;
+        sound_play(SOUND_MUSIC, &music_song);
+    }
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    signal(SIGUSR1, request_latency);
+
+    printf("Running game with seed %u...\n", seed);
+
+    rng = rng_seed(seed);
+
+    if (pipelined && !render)
+        pipelined = 0;
+    if (pipelined && sysconf(_SC_NPROCESSORS_ONLN) < 2)
+    {
+        printf("Single core, rendering serially\n");
+        pipelined = 0;
+    }
+
+    init_game();
+
+    length = snake.length;
+    if (!fast && (ticker_init(tick_period(length)) || watch_fd(ticker_fd())))
+        return 1;
+
+    if (pipelined && start_render_thread(&render_thread))
+        return 1;
+
+    start = walltime();
+
+    /* Simulation runs at the tick rate, the display is flushed once per
+       wakeup so an overrun skips frames rather than slowing the game. With
+       a render thread the wakeup only publishes the board, the thread draws
+       and flushes the latest one meanwhile. */
+    while (running && (pipelined || max_frames == 0 || frames < max_frames))
+    {
+        ticks = wait_ticks(fast);
+        if (ticks < 0)
+            break;
+        frame_start = walltime();
+        if (ticks > MAX_CATCHUP_TICKS)
+            ticks = MAX_CATCHUP_TICKS;
+
+        done = 0;
+        while (done < ticks && running)
         {
-            init_game();
+            if (update_game())
+                running = 0;
+            else
+                done++;
         }
 
-        /* Draw apple */
-        draw_square(apple.x, apple.y, SQUARE_SIZE, COLOR_APPLE);
+        total_ticks += done;
+        if (done == 0 && !running)
+            break;
+
+        if (pipelined)
+            publish_snapshot();
+        else
+            present_frame(frame_start);
 
-        ioctl(screen_fd, 0x4680, &screen_region);
+        /* Printed here as SIGUSR1 is only delivered to this thread */
+        if (print_latency)
+        {
+            print_latency = 0;
+            print_latencies();
+        }
+
+        if (!fast && snake.length != length)
+        {
+            length = snake.length;
+            ticker_set_period(tick_period(length));
+        }
     }
 
-    fclose(gamepad);
-    munmap(screen, window_w * window_h * sizeof(pixel_t));
-    close(screen_fd);
+    if (pipelined)
+        stop_render_thread(render_thread);
 
-    return 0;
+    report_rates(frames, total_ticks, walltime() - start);
+    if (!replaying && !autopilot)
+        print_latencies();
+
+    replay_close(tick);
+    if (hud)
+        hud_close();
+    if (autopilot)
+    {
+        autopilot_destroy(&pilot);
+        autopilot_plan_destroy(&plan);
+    }
+    snake_destroy(&snake);
+    if (!fast)
+        ticker_close();
+    input_close();
+    sound_close();
+    close(epoll_fd);
+    status = display_close();
+
+    return status;
 }
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hud.h"
+#include "font.h"
+#include "damage.h"
+
+/* Text lines, times are in milliseconds */
+enum { HUD_FPS, HUD_P50, HUD_P99, HUD_FLUSH, HUD_LENGTH, HUD_LINES };
+
+#define HUD_CHARS 11
+
+static Surface *hud_surface;
+static Font hud_font;
+static int hud_x;
+static int hud_y;
+
+/* Text shown on screen and text to show, a line is only redrawn when they
+   differ or something was drawn over it */
+static char shown[HUD_LINES][HUD_CHARS + 1];
+static char text[HUD_LINES][HUD_CHARS + 1];
+static int overdrawn = 1;
+
+/* Frame and flush times of the current window */
+static double frame_times[HUD_WINDOW];
+static double flush_total;
+static int n_frames;
+static double window_start;
+
+static int compare_times(const void *a, const void *b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Places the HUD with its top left corner at (x, y) of 'surface' */
+int hud_init(Surface *surface, int x, int y, pixel_t fg, pixel_t bg)
+{
+    if (font_init(&hud_font, surface, fg, bg))
+    {
+        printf("Failed to allocate HUD font\n");
+        return 1;
+    }
+
+    hud_surface = surface;
+    hud_x = x;
+    hud_y = y;
+    window_start = 0;
+
+    for (int i = 0; i < HUD_LINES; i++)
+        text[i][0] = shown[i][0] = '\0';
+
+    return 0;
+}
+
+/* Accounts a frame finished at 'time' that took 'frame_time' seconds,
+   'flush_time' of them presenting, the text is updated every window */
+void hud_frame(double time, double frame_time, double flush_time,
+    int length)
+{
+    if (window_start == 0)
+        window_start = time - frame_time;
+
+    frame_times[n_frames++] = frame_time;
+    flush_total += flush_time;
+
+    snprintf(text[HUD_LENGTH], HUD_CHARS + 1, "LEN %7d", length);
+
+    if (n_frames < HUD_WINDOW)
+        return;
+
+    qsort(frame_times, n_frames, sizeof(double), compare_times);
+
+    snprintf(text[HUD_FPS], HUD_CHARS + 1, "FPS %7.1f",
+        n_frames / (time - window_start));
+    snprintf(text[HUD_P50], HUD_CHARS + 1, "P50 %7.2f",
+        frame_times[n_frames / 2] * 1e3);
+    snprintf(text[HUD_P99], HUD_CHARS + 1, "P99 %7.2f",
+        frame_times[n_frames * 99 / 100] * 1e3);
+    snprintf(text[HUD_FLUSH], HUD_CHARS + 1, "FLS %7.2f",
+        flush_total / n_frames * 1e3);
+
+    n_frames = 0;
+    flush_total = 0;
+    window_start = time;
+}
+
+/* Notes that the region at (x, y) was drawn over, redrawing the HUD on the
+   next hud_draw if it overlaps */
+void hud_touch(int x, int y, int w, int h)
+{
+    if (x < hud_x + HUD_CHARS * FONT_WIDTH && x + w > hud_x &&
+        y < hud_y + HUD_LINES * FONT_HEIGHT && y + h > hud_y)
+        overdrawn = 1;
+}
+
+/* Draws the lines whose text changed */
+void hud_draw(void)
+{
+    int y = hud_y;
+    int w;
+
+    for (int i = 0; i < HUD_LINES; i++, y += FONT_HEIGHT)
+    {
+        if (!overdrawn && strcmp(text[i], shown[i]) == 0)
+            continue;
+
+        w = font_draw(&hud_font, hud_surface, hud_x, y, text[i]);
+        if (w > 0)
+            damage_add(hud_x, y, w, FONT_HEIGHT);
+        strcpy(shown[i], text[i]);
+    }
+
+    overdrawn = 0;
+}
+
+void hud_close(void)
+{
+    font_free(&hud_font);
+}
@@ -0,0 +1,16 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include "blit.h"
+
+/* Frames summarized per HUD update */
+#define HUD_WINDOW 32
+
+int hud_init(Surface *surface, int x, int y, pixel_t fg, pixel_t bg);
+void hud_frame(double time, double frame_time, double flush_time,
+    int length);
+void hud_touch(int x, int y, int w, int h);
+void hud_draw(void);
+void hud_close(void);
+
+#endif /* HUD_H */
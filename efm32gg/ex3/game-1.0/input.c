@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "input.h"
+
+static const InputBackend *backends[] = {
+    &input_gamepad,
+    &input_evdev,
+    &input_terminal,
+    &input_script
+};
+
+static const InputBackend *backend = NULL;
+static int fd = -1;
+
+/* Opens the backend called 'name' on 'path', or on its default device if
+   'path' is NULL
+
+   Returns 1 if there is no such backend or it fails to start.
+*/
+int input_init(const char *name, const char *path)
+{
+    for (int i = 0; i < sizeof(backends) / sizeof(backends[0]); i++)
+        if (strcmp(backends[i]->name, name) == 0)
+            backend = backends[i];
+
+    if (backend == NULL)
+    {
+        printf("Unknown input backend '%s'\n", name);
+        return 1;
+    }
+
+    fd = backend->init(path);
+    if (fd == -1)
+    {
+        backend = NULL;
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Returns the descriptor that becomes readable on input, -1 without input */
+int input_fd(void)
+{
+    return fd;
+}
+
+/* Returns 1 if the input is read once per tick rather than when ready */
+int input_polled(void)
+{
+    return backend != NULL && backend->polled;
+}
+
+/* Hands the pending presses to 'handler', stamped with 'time' unless the
+   device reports its own
+
+   Returns 1 once the input has ended and need not be waited on anymore.
+*/
+int input_read(InputHandler handler, double time)
+{
+    if (backend == NULL)
+        return 1;
+
+    return backend->read(handler, time);
+}
+
+void input_close(void)
+{
+    if (backend != NULL)
+        backend->close();
+
+    backend = NULL;
+    fd = -1;
+}
@@ -0,0 +1,37 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "snake.h"
+
+typedef struct InputBackend InputBackend;
+
+/* Called for every direction pressed, 'time' is when the press was read or,
+   where the device reports it, when it happened */
+typedef void (*InputHandler)(int direction, double time);
+
+/* Input implementation, 'init' opens 'path' or the backend's default device
+   when it is NULL and returns the descriptor to wait on, or -1. 'read'
+   hands the pending presses to 'handler' and returns 1 once the stream has
+   ended. 'polled' backends are read once per tick instead of whenever the
+   descriptor is readable. */
+struct InputBackend
+{
+    const char *name;
+    int polled;
+    int (*init)(const char *path);
+    int (*read)(InputHandler handler, double time);
+    void (*close)(void);
+};
+
+extern const InputBackend input_gamepad;
+extern const InputBackend input_evdev;
+extern const InputBackend input_terminal;
+extern const InputBackend input_script;
+
+int input_init(const char *name, const char *path);
+int input_fd(void);
+int input_polled(void);
+int input_read(InputHandler handler, double time);
+void input_close(void);
+
+#endif /* INPUT_H */
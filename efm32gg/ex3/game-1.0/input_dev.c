@@ -0,0 +1,216 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 1
+#define _GNU_SOURCE 1
+#endif /* _POSIX_C_SOURCE */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+
+#include "input.h"
+
+/* Extracts bit 'n' of 's' */
+#define BIT(s, n) (((s) >> (n)) & 1U)
+
+/* Older kernel headers name the event timestamp fields directly */
+#ifndef input_event_sec
+#define input_event_sec time.tv_sec
+#define input_event_usec time.tv_usec
+#endif
+
+/* Key mapping according to bit possition */
+enum { SW1, SW2, SW3, SW4, SW5, SW6, SW7, SW8 };
+
+static int fd = -1;
+
+/* Buttons held down in the last gamepad state */
+static uint8_t held = 0x00;
+
+/* Set once the evdev device stamps events with the monotonic clock */
+static int device_time = 0;
+
+/* Opens the device at 'path' for non-blocking reads */
+static int open_device(const char *path)
+{
+    fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+
+    if (fd == -1)
+        printf("Failed opening input device %s\n", path);
+
+    return fd;
+}
+
+/* Returns 1 if a failed read means the device is gone */
+static int read_failed(ssize_t n)
+{
+    return n == 0 || (errno != EAGAIN && errno != EINTR);
+}
+
+static void device_close(void)
+{
+    close(fd);
+    fd = -1;
+}
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Gamepad driver
+ *
+ *----------------------------------------------------------------------------*/
+
+
+static int gamepad_init(const char *path)
+{
+    held = 0x00;
+    return open_device(path ? path : "/dev/gamepad");
+}
+
+/* Hands a press for every button that went down in the gamepad state
+   'state', the driver reports releases too so 'held' clears between presses */
+static void handle_buttons(uint8_t state, InputHandler handler, double time)
+{
+    uint8_t pressed = ~state;
+    uint8_t down = pressed & ~held;
+
+    held = pressed;
+
+    if (BIT(down, SW1))
+        handler(LEFT, time);
+    if (BIT(down, SW2))
+        handler(UP, time);
+    if (BIT(down, SW3))
+        handler(RIGHT, time);
+    if (BIT(down, SW4))
+        handler(DOWN, time);
+}
+
+/* Reads every pending gamepad event, the driver returns one state byte per
+   button edge so presses within one tick are all seen
+
+   Events are stamped when read, latencies measured from here include the
+   wakeup of the game but not the debouncing in the driver.
+*/
+static int gamepad_read(InputHandler handler, double time)
+{
+    uint8_t states[32];
+    ssize_t n;
+
+    while ((n = read(fd, states, sizeof(states))) > 0)
+        for (ssize_t i = 0; i < n; i++)
+            handle_buttons(states[i], handler, time);
+
+    return read_failed(n);
+}
+
+const InputBackend input_gamepad = {
+    "gamepad", 0, gamepad_init, gamepad_read, device_close
+};
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Evdev keyboards and gamepads
+ *
+ *----------------------------------------------------------------------------*/
+
+
+static int evdev_init(const char *path)
+{
+    int clock = CLOCK_MONOTONIC;
+
+    if (open_device(path ? path : "/dev/input/event0") == -1)
+        return -1;
+
+    /* Event times are then comparable with the game's clock */
+    device_time = ioctl(fd, EVIOCSCLOCKID, &clock) == 0;
+
+    return fd;
+}
+
+/* Returns the direction of the key 'code', or -1 for other keys */
+static int key_direction(int code)
+{
+    switch (code)
+    {
+    case KEY_UP:
+    case KEY_W:
+#ifdef BTN_DPAD_UP
+    case BTN_DPAD_UP:
+#endif
+        return UP;
+    case KEY_DOWN:
+    case KEY_S:
+#ifdef BTN_DPAD_DOWN
+    case BTN_DPAD_DOWN:
+#endif
+        return DOWN;
+    case KEY_RIGHT:
+    case KEY_D:
+#ifdef BTN_DPAD_RIGHT
+    case BTN_DPAD_RIGHT:
+#endif
+        return RIGHT;
+    case KEY_LEFT:
+    case KEY_A:
+#ifdef BTN_DPAD_LEFT
+    case BTN_DPAD_LEFT:
+#endif
+        return LEFT;
+    default:
+        return -1;
+    }
+}
+
+/* Returns the direction of the event 'event', or -1 if it is not a press of
+   a direction key or hat */
+static int event_direction(const struct input_event *event)
+{
+    if (event->type == EV_KEY && event->value == 1)
+        return key_direction(event->code);
+
+    if (event->type == EV_ABS && event->value != 0)
+    {
+        if (event->code == ABS_HAT0X)
+            return event->value < 0 ? LEFT : RIGHT;
+        if (event->code == ABS_HAT0Y)
+            return event->value < 0 ? UP : DOWN;
+    }
+
+    return -1;
+}
+
+/* Reads every pending event, key repeats are ignored and presses are
+   stamped with the time the kernel saw them when it can use our clock */
+static int evdev_read(InputHandler handler, double time)
+{
+    struct input_event events[16];
+    int direction;
+    ssize_t n;
+
+    while ((n = read(fd, events, sizeof(events))) > 0)
+    {
+        for (int i = 0; i < n / sizeof(events[0]); i++)
+        {
+            direction = event_direction(&events[i]);
+            if (direction == -1)
+                continue;
+
+            if (device_time)
+                time = events[i].input_event_sec +
+                    events[i].input_event_usec * 1.0e-6;
+            handler(direction, time);
+        }
+    }
+
+    return read_failed(n);
+}
+
+const InputBackend input_evdev = {
+    "evdev", 0, evdev_init, evdev_read, device_close
+};
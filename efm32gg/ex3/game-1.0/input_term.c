@@ -0,0 +1,236 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 1
+#define _GNU_SOURCE 1
+#endif /* _POSIX_C_SOURCE */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <termios.h>
+
+#include "input.h"
+
+static int fd = -1;
+
+/* Terminal settings to restore, valid while 'raw' is set */
+static struct termios saved;
+static int raw = 0;
+
+/* Position within an escape sequence, 1 after ESC and 2 after ESC [ */
+static int escape = 0;
+
+/* Descriptor flags of the script stream before it was made non-blocking */
+static int saved_flags = -1;
+
+/* Returns the direction of the key 'c', or -1 for other keys */
+static int key_direction(int c)
+{
+    switch (c)
+    {
+    case 'w':
+    case 'W':
+        return UP;
+    case 's':
+    case 'S':
+        return DOWN;
+    case 'd':
+    case 'D':
+        return RIGHT;
+    case 'a':
+    case 'A':
+        return LEFT;
+    default:
+        return -1;
+    }
+}
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Raw terminal
+ *
+ *----------------------------------------------------------------------------*/
+
+
+static void restore_terminal(void)
+{
+    if (raw)
+        tcsetattr(fd, TCSAFLUSH, &saved);
+    raw = 0;
+}
+
+/* Puts the terminal at 'path', the controlling one by default, into
+   non-canonical mode without echo so every key is read as it is pressed,
+   keeping ^C as SIGINT */
+static int terminal_init(const char *path)
+{
+    struct termios settings;
+
+    fd = open(path ? path : "/dev/tty", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+
+    if (fd == -1 || tcgetattr(fd, &saved) == -1)
+    {
+        printf("Failed opening terminal\n");
+        return -1;
+    }
+
+    settings = saved;
+    settings.c_lflag &= ~(ICANON | ECHO);
+    /* With a minimum of 0 an empty read would look like end of file, the
+       descriptor is non-blocking so reads return EAGAIN instead */
+    settings.c_cc[VMIN] = 1;
+    settings.c_cc[VTIME] = 0;
+
+    if (tcsetattr(fd, TCSAFLUSH, &settings) == -1)
+    {
+        printf("Failed setting terminal mode\n");
+        return -1;
+    }
+
+    /* The game exits through main on errors too, leave the terminal sane */
+    if (!raw)
+        atexit(restore_terminal);
+    raw = 1;
+    escape = 0;
+
+    return fd;
+}
+
+/* Returns the direction of the arrow key ending an ESC [ sequence in 'c' */
+static int arrow_direction(int c)
+{
+    switch (c)
+    {
+    case 'A':
+        return UP;
+    case 'B':
+        return DOWN;
+    case 'C':
+        return RIGHT;
+    case 'D':
+        return LEFT;
+    default:
+        return -1;
+    }
+}
+
+/* Reads every pending key, arrow keys arrive as ESC [ A to D and may be
+   split across reads */
+static int terminal_read(InputHandler handler, double time)
+{
+    unsigned char keys[32];
+    int direction;
+    ssize_t n;
+
+    while ((n = read(fd, keys, sizeof(keys))) > 0)
+    {
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (keys[i] == 0x1b)
+            {
+                escape = 1;
+                continue;
+            }
+
+            if (escape == 1)
+                escape = keys[i] == '[' ? 2 : 0;
+            else if (escape == 2)
+            {
+                escape = 0;
+                direction = arrow_direction(keys[i]);
+                if (direction != -1)
+                    handler(direction, time);
+            }
+            else if ((direction = key_direction(keys[i])) != -1)
+                handler(direction, time);
+        }
+    }
+
+    return n == 0 || (errno != EAGAIN && errno != EINTR);
+}
+
+static void terminal_close(void)
+{
+    restore_terminal();
+    close(fd);
+    fd = -1;
+}
+
+const InputBackend input_terminal = {
+    "terminal", 0, terminal_init, terminal_read, terminal_close
+};
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Scripted stream
+ *
+ *----------------------------------------------------------------------------*/
+
+
+/* Opens the script at 'path', standard input if it is NULL or "-"
+
+   Scripts hold one line per tick with the keys pressed on it, using the
+   same WASD letters as the terminal, e.g. "d\n\nw\n" turns right, waits a
+   tick and turns up. Reads never block, a generator piping in lines slower
+   than the tick rate simply leaves ticks without presses.
+*/
+static int script_init(const char *path)
+{
+    if (path == NULL || strcmp(path, "-") == 0)
+        fd = STDIN_FILENO;
+    else
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1)
+    {
+        printf("Failed opening script %s\n", path);
+        return -1;
+    }
+
+    saved_flags = fcntl(fd, F_GETFL);
+    if (saved_flags == -1 ||
+        fcntl(fd, F_SETFL, saved_flags | O_NONBLOCK) == -1)
+    {
+        printf("Failed making script non-blocking\n");
+        return -1;
+    }
+
+    return fd;
+}
+
+/* Hands out the presses on the next line of the script
+
+   Lines are read a byte at a time so the rest stays in the stream for the
+   following ticks, whatever the stream is. Returns 1 at the end of it.
+*/
+static int script_read(InputHandler handler, double time)
+{
+    unsigned char c;
+    int direction;
+    ssize_t n;
+
+    while ((n = read(fd, &c, 1)) == 1 && c != '\n')
+        if ((direction = key_direction(c)) != -1)
+            handler(direction, time);
+
+    if (n == 1)
+        return 0;
+
+    return n == 0 || (errno != EAGAIN && errno != EINTR);
+}
+
+static void script_close(void)
+{
+    fcntl(fd, F_SETFL, saved_flags);
+    if (fd != STDIN_FILENO)
+        close(fd);
+    fd = -1;
+}
+
+const InputBackend input_script = {
+    "script", 1, script_init, script_read, script_close
+};
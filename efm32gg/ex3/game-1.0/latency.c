@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "latency.h"
+
+static int compare_samples(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Records a delay of 'seconds', replacing the oldest sample once the
+   window is full */
+void latency_add(Latency *latency, double seconds)
+{
+    double us = seconds * 1e6;
+
+    latency->samples[latency->count++ & (LATENCY_WINDOW - 1)] =
+        us < 0 ? 0 : us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+/* Prints percentiles and a log2 histogram of the samples in the window */
+void latency_print(const Latency *latency)
+{
+    uint32_t sorted[LATENCY_WINDOW];
+    uint32_t buckets[LATENCY_BUCKETS] = { 0 };
+    int n = latency->count < LATENCY_WINDOW ? latency->count : LATENCY_WINDOW;
+    int b;
+
+    if (n == 0)
+    {
+        printf("%s: no samples\n", latency->name);
+        return;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        sorted[i] = latency->samples[i];
+        for (b = 0; b < LATENCY_BUCKETS - 1 && sorted[i] >> (b + 1); b++)
+            ;
+        buckets[b]++;
+    }
+    qsort(sorted, n, sizeof(uint32_t), compare_samples);
+
+    printf("%s: last %d of %u, p50 %u us, p99 %u us, max %u us\n",
+        latency->name, n, latency->count, sorted[n / 2], sorted[n * 99 / 100],
+        sorted[n - 1]);
+
+    for (b = 0; b < LATENCY_BUCKETS; b++)
+        if (buckets[b])
+            printf("  %8lu - %8lu us: %u\n", b ? 1UL << b : 0, (2UL << b) - 1,
+                buckets[b]);
+}
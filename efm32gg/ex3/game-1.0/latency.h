@@ -0,0 +1,24 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+/* Most recent samples kept, must be a power of two */
+#define LATENCY_WINDOW 1024
+
+/* Histogram buckets, bucket n counts [2^n, 2^(n+1)) microseconds */
+#define LATENCY_BUCKETS 24
+
+typedef struct Latency Latency;
+
+struct Latency
+{
+    const char *name;
+    uint32_t samples[LATENCY_WINDOW];
+    uint32_t count;
+};
+
+void latency_add(Latency *latency, double seconds);
+void latency_print(const Latency *latency);
+
+#endif /* LATENCY_H */
@@ -0,0 +1,132 @@
+#include <stdio.h>
+
+#include "pool.h"
+
+/* Runs chunks of the current job until none are left, first from the share
+   of worker 'index', then from the others */
+static void work(Pool *pool, int index)
+{
+    PoolWorker *victim;
+    int chunk;
+
+    for (int i = 0; i < pool->n_workers; i++)
+    {
+        victim = &pool->workers[(index + i) % pool->n_workers];
+
+        while ((chunk = __atomic_fetch_add(&victim->next, 1,
+            __ATOMIC_RELAXED)) < victim->end)
+            pool->task(pool->arg, chunk, index);
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    PoolWorker *self = arg;
+    Pool *pool = self->pool;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->job == self->job && !pool->quit)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->quit)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        self->job = pool->job;
+        pthread_mutex_unlock(&pool->lock);
+
+        work(pool, self->index);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0)
+            pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/* Starts 'n_workers' - 1 threads, the caller of pool_run is worker 0 */
+int pool_init(Pool *pool, int n_workers)
+{
+    if (n_workers < 1 || n_workers > POOL_MAX_WORKERS)
+    {
+        printf("Unsupported number of workers\n");
+        return 1;
+    }
+
+    pool->n_workers = n_workers;
+    pool->job = 0;
+    pool->busy = 0;
+    pool->quit = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (int i = 0; i < n_workers; i++)
+    {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        pool->workers[i].job = 0;
+        pool->workers[i].next = pool->workers[i].end = 0;
+
+        if (i > 0 && pthread_create(&pool->workers[i].thread, NULL,
+            worker_main, &pool->workers[i]))
+        {
+            printf("Failed to start worker thread\n");
+            pool->n_workers = i;
+            pool_free(pool);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Runs 'task' on chunks 0 to 'n_chunks' - 1 across the pool and returns
+   once all of them are done
+
+   Every worker is handed an equal contiguous share of the chunks, idle
+   workers then take chunks from the shares of busy ones.
+*/
+void pool_run(Pool *pool, PoolTask task, void *arg, int n_chunks)
+{
+    int n = pool->n_workers;
+
+    pool->task = task;
+    pool->arg = arg;
+    for (int i = 0; i < n; i++)
+    {
+        pool->workers[i].next = (long)n_chunks * i / n;
+        pool->workers[i].end = (long)n_chunks * (i + 1) / n;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->busy = n - 1;
+    pool->job++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    work(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Stops and joins the worker threads */
+void pool_free(Pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->n_workers; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+}
@@ -0,0 +1,50 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+
+/* Most workers a pool can have */
+#define POOL_MAX_WORKERS 64
+
+typedef struct Pool Pool;
+typedef struct PoolWorker PoolWorker;
+
+/* Runs chunk 'chunk' of a job on worker 'worker' */
+typedef void (*PoolTask)(void *arg, int chunk, int worker);
+
+/* Chunks [next, end) of a job not yet taken from a worker, padded to a
+   cache line so workers do not contend on each other's counters */
+struct PoolWorker
+{
+    int next;
+    int end;
+
+    Pool *pool;
+    int index;
+    pthread_t thread;
+    unsigned int job;
+} __attribute__((aligned(64)));
+
+/* Worker threads that split each job into chunks, every worker starts on a
+   share of its own and steals from the others when it runs out */
+struct Pool
+{
+    PoolWorker workers[POOL_MAX_WORKERS];
+    int n_workers;
+
+    PoolTask task;
+    void *arg;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned int job;
+    int busy;
+    int quit;
+};
+
+int pool_init(Pool *pool, int n_workers);
+void pool_run(Pool *pool, PoolTask task, void *arg, int n_chunks);
+void pool_free(Pool *pool);
+
+#endif /* POOL_H */
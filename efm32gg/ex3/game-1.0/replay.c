@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "replay.h"
+
+/* Session log layout, all integers little endian:
+
+     "SNK2"  magic
+     u32     PRNG seed
+     u32 u32 board width and height in cells
+     u32 u8  tick and direction, once per turn
+     u32 ff  tick the session ended on
+*/
+#define REPLAY_MAGIC "SNK2"
+#define REPLAY_END_MARK 0xff
+
+static FILE *replay_file = NULL;
+static int recording = 0;
+
+/* Next turn read ahead from the log */
+static uint32_t next_tick;
+static int next_direction = REPLAY_END;
+
+static void write_u32(uint32_t value)
+{
+    uint8_t bytes[4] = { value, value >> 8, value >> 16, value >> 24 };
+
+    fwrite(bytes, 1, 4, replay_file);
+}
+
+static int read_u32(uint32_t *value)
+{
+    uint8_t bytes[4];
+
+    if (fread(bytes, 1, 4, replay_file) != 4)
+        return 1;
+
+    *value = bytes[0] | bytes[1] << 8 | bytes[2] << 16 |
+        (uint32_t)bytes[3] << 24;
+    return 0;
+}
+
+/* Reads the next turn, a truncated log ends the session at its last turn */
+static void read_ahead(void)
+{
+    int direction;
+
+    if (read_u32(&next_tick) || (direction = fgetc(replay_file)) == EOF)
+    {
+        next_tick = 0;
+        next_direction = REPLAY_END;
+    }
+    else if (direction == REPLAY_END_MARK)
+        next_direction = REPLAY_END;
+    else
+        next_direction = direction;
+}
+
+/* Creates the log at 'path' for a session seeded with 'seed' on a 'width'
+   x 'height' board */
+int replay_record(const char *path, uint32_t seed, uint32_t width,
+    uint32_t height)
+{
+    replay_file = fopen(path, "wb");
+
+    if (replay_file == NULL)
+    {
+        printf("Failed to create replay %s\n", path);
+        return 1;
+    }
+
+    recording = 1;
+    fwrite(REPLAY_MAGIC, 1, 4, replay_file);
+    write_u32(seed);
+    write_u32(width);
+    write_u32(height);
+
+    return 0;
+}
+
+/* Logs that the snake turned to 'direction' on 'tick' */
+void replay_write(uint32_t tick, int direction)
+{
+    write_u32(tick);
+    fputc(direction, replay_file);
+}
+
+/* Opens the log at 'path' and reads the seed and board size of its
+   session */
+int replay_open(const char *path, uint32_t *seed, uint32_t *width,
+    uint32_t *height)
+{
+    char magic[4];
+
+    replay_file = fopen(path, "rb");
+
+    if (replay_file == NULL)
+    {
+        printf("Failed to open replay %s\n", path);
+        return 1;
+    }
+
+    if (fread(magic, 1, 4, replay_file) != 4 ||
+        memcmp(magic, REPLAY_MAGIC, 4) != 0 || read_u32(seed) ||
+        read_u32(width) || read_u32(height))
+    {
+        printf("Invalid replay %s\n", path);
+        return 1;
+    }
+
+    read_ahead();
+
+    return 0;
+}
+
+/* Returns the direction the snake turned to on 'tick', REPLAY_NONE if it
+   did not turn or REPLAY_END once the session is over
+
+   Ticks must be passed in increasing order.
+*/
+int replay_read(uint32_t tick)
+{
+    int direction;
+
+    if (tick < next_tick)
+        return REPLAY_NONE;
+    if (next_direction == REPLAY_END)
+        return REPLAY_END;
+
+    direction = next_direction;
+    read_ahead();
+
+    return direction;
+}
+
+/* Closes the log, a recorded session is marked as ending on 'tick' */
+void replay_close(uint32_t tick)
+{
+    if (replay_file == NULL)
+        return;
+
+    if (recording)
+    {
+        write_u32(tick);
+        fputc(REPLAY_END_MARK, replay_file);
+    }
+
+    fclose(replay_file);
+    replay_file = NULL;
+}
@@ -0,0 +1,20 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+
+/* Returned by replay_read once the recorded session has ended */
+#define REPLAY_END -2
+
+/* Returned by replay_read for ticks without a turn */
+#define REPLAY_NONE -1
+
+int replay_record(const char *path, uint32_t seed, uint32_t width,
+    uint32_t height);
+void replay_write(uint32_t tick, int direction);
+int replay_open(const char *path, uint32_t *seed, uint32_t *width,
+    uint32_t *height);
+int replay_read(uint32_t tick);
+void replay_close(uint32_t tick);
+
+#endif /* REPLAY_H */
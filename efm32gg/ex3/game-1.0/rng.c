@@ -0,0 +1,23 @@
+#include "rng.h"
+
+/* Used in place of a zero seed, which xorshift cannot leave */
+#define RNG_DEFAULT_STATE 2463534242U
+
+/* Returns the generator state for 'seed', equal seeds give equal sequences */
+uint32_t rng_seed(uint32_t seed)
+{
+    return seed ? seed : RNG_DEFAULT_STATE;
+}
+
+/* Advances the 32 bit xorshift generator at 'state' and returns its next
+   number */
+uint32_t rng_next(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return *state = x;
+}
@@ -0,0 +1,9 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+uint32_t rng_seed(uint32_t seed);
+uint32_t rng_next(uint32_t *state);
+
+#endif /* RNG_H */
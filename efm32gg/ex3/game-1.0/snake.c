@@ -0,0 +1,190 @@
+#include <stdlib.h>
+
+#include "snake.h"
+
+/* Entry 'i' of the free list */
+static inline cell_t free_cell(const Snake *snake, int i)
+{
+    return snake->free_cells[i] ^ i;
+}
+
+/* Position of free cell 'cell' in the free list */
+static inline int free_position(const Snake *snake, cell_t cell)
+{
+    return snake->free_index[cell] ^ cell;
+}
+
+static inline void free_set(Snake *snake, int i, cell_t cell)
+{
+    snake->free_cells[i] = cell ^ i;
+    snake->free_index[cell] = i ^ cell;
+}
+
+static void free_remove(Snake *snake, cell_t cell)
+{
+    int i = free_position(snake, cell);
+    cell_t last = free_cell(snake, --snake->n_free);
+
+    free_set(snake, i, last);
+}
+
+static void free_add(Snake *snake, cell_t cell)
+{
+    free_set(snake, snake->n_free++, cell);
+}
+
+/* Allocates an empty 'width' x 'height' board
+
+   Returns 1 if the size is not supported or memory ran out.
+*/
+int snake_create(Snake *snake, int width, int height)
+{
+    if (width < 4 || height < 4 ||
+        width > BOARD_MAX_SIDE || height > BOARD_MAX_SIDE)
+        return 1;
+
+    snake->width = width;
+    snake->height = height;
+    snake->n_cells = width * height;
+    snake->head = snake->n_cells - 1;
+    snake->length = 0;
+    snake->n_free = snake->n_cells;
+
+    snake->body = calloc(snake->n_cells, sizeof(cell_t));
+    snake->occupied = calloc((snake->n_cells + 31) / 32, sizeof(uint32_t));
+    snake->free_cells = calloc(snake->n_cells, sizeof(cell_t));
+    snake->free_index = calloc(snake->n_cells, sizeof(cell_t));
+
+    if (!snake->body || !snake->occupied || !snake->free_cells ||
+        !snake->free_index)
+    {
+        snake_destroy(snake);
+        return 1;
+    }
+
+    return 0;
+}
+
+void snake_destroy(Snake *snake)
+{
+    free(snake->body);
+    free(snake->occupied);
+    free(snake->free_cells);
+    free(snake->free_index);
+    snake->body = NULL;
+    snake->occupied = NULL;
+    snake->free_cells = NULL;
+    snake->free_index = NULL;
+}
+
+/* Places a straight snake of 'length' segments with its head at (x, y),
+   the body trailing to the left
+
+   Any previous snake is popped off first, so restarting costs the length
+   of the old snake rather than the area of the board.
+*/
+void snake_init(Snake *snake, int x, int y, int length)
+{
+    while (snake->length > 0)
+        snake_pop(snake);
+
+    for (int i = length - 1; i >= 0; i--)
+        snake_push(snake, CELL(snake,
+            (x - i + snake->width) % snake->width, y));
+}
+
+/* Moves the head onto 'cell', growing the snake by one segment
+
+   'cell' must not be covered by the snake.
+*/
+void snake_push(Snake *snake, cell_t cell)
+{
+    if (++snake->head == snake->n_cells)
+        snake->head = 0;
+    snake->body[snake->head] = cell;
+    snake->length++;
+
+    snake->occupied[cell / 32] |= 1U << (cell % 32);
+    free_remove(snake, cell);
+}
+
+/* Removes and returns the tail segment */
+cell_t snake_pop(Snake *snake)
+{
+    cell_t tail = snake_tail(snake);
+    snake->length--;
+
+    snake->occupied[tail / 32] &= ~(1U << (tail % 32));
+    free_add(snake, tail);
+
+    return tail;
+}
+
+cell_t snake_head(const Snake *snake)
+{
+    return snake->body[snake->head];
+}
+
+cell_t snake_tail(const Snake *snake)
+{
+    return snake_segment(snake, snake->length - 1);
+}
+
+/* Returns segment 'i' counted from the head */
+cell_t snake_segment(const Snake *snake, int i)
+{
+    int index = snake->head - i;
+
+    if (index < 0)
+        index += snake->n_cells;
+
+    return snake->body[index];
+}
+
+/* Returns the neighbour of 'cell' in 'direction' on the board of 'snake',
+   wrapping around the board edges */
+cell_t cell_step(const Snake *snake, cell_t cell, int direction)
+{
+    int x = CELL_X(snake, cell);
+    int y = CELL_Y(snake, cell);
+
+    switch (direction)
+    {
+    case UP:
+        y = y == 0 ? snake->height - 1 : y - 1;
+        break;
+    case DOWN:
+        y = y == snake->height - 1 ? 0 : y + 1;
+        break;
+    case RIGHT:
+        x = x == snake->width - 1 ? 0 : x + 1;
+        break;
+    case LEFT:
+        x = x == 0 ? snake->width - 1 : x - 1;
+        break;
+    }
+
+    return CELL(snake, x, y);
+}
+
+/* Returns the cell the head moves onto in 'direction' */
+cell_t snake_next(const Snake *snake, int direction)
+{
+    return cell_step(snake, snake_head(snake), direction);
+}
+
+/* Returns 1 if 'cell' is covered by the snake */
+int snake_collision(const Snake *snake, cell_t cell)
+{
+    return (snake->occupied[cell / 32] >> (cell % 32)) & 1U;
+}
+
+/* Returns the free cell picked by the random number 'r'
+
+   Every free cell is equally likely for uniform 'r'. There must be at least
+   one free cell.
+*/
+cell_t snake_free_cell(const Snake *snake, unsigned int r)
+{
+    return free_cell(snake, r % snake->n_free);
+}
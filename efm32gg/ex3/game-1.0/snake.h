@@ -0,0 +1,67 @@
+#ifndef SNAKE_H
+#define SNAKE_H
+
+#include <inttypes.h>
+
+/* Default board dimensions in squares */
+#define N_SQUARES_X (int)(32)
+#define N_SQUARES_Y (int)(24)
+#define N_SQUARES (int)(N_SQUARES_X * N_SQUARES_Y)
+
+/* Longest board side in squares */
+#define BOARD_MAX_SIDE 4096
+
+/* Packs and unpacks board coordinates of 'snake' into a cell index */
+#define CELL(snake, x, y) (cell_t)((y) * (snake)->width + (x))
+#define CELL_X(snake, c) ((int)((c) % (snake)->width))
+#define CELL_Y(snake, c) ((int)((c) / (snake)->width))
+
+/* Snake movement directions */
+enum { UP, DOWN, RIGHT, LEFT };
+
+typedef uint32_t cell_t;
+
+typedef struct Snake Snake;
+
+/* Snake on a 'width' x 'height' board, 'n_cells' squares in all
+
+   The body is a circular buffer of cells, 'body[head]' is the head and the
+   'length - 1' cells before it, wrapping around, are the rest.
+
+   'occupied' holds one bit per cell covered by the body. The cells not
+   covered are kept unordered in the first 'n_free' entries of 'free_cells',
+   with 'free_index' locating each of them so removal is a swap with the
+   last entry. Both are stored XORed with their own index, so the zeroed
+   memory they are allocated as already reads as every cell being free in
+   order, and pages of a large board are only touched once played on.
+*/
+struct Snake
+{
+    int width;
+    int height;
+    int n_cells;
+
+    cell_t *body;
+    int head;
+    int length;
+
+    uint32_t *occupied;
+    cell_t *free_cells;
+    cell_t *free_index;
+    int n_free;
+};
+
+int snake_create(Snake *snake, int width, int height);
+void snake_destroy(Snake *snake);
+void snake_init(Snake *snake, int x, int y, int length);
+void snake_push(Snake *snake, cell_t cell);
+cell_t snake_pop(Snake *snake);
+cell_t snake_head(const Snake *snake);
+cell_t snake_tail(const Snake *snake);
+cell_t snake_segment(const Snake *snake, int i);
+cell_t snake_next(const Snake *snake, int direction);
+cell_t cell_step(const Snake *snake, cell_t cell, int direction);
+int snake_collision(const Snake *snake, cell_t cell);
+cell_t snake_free_cell(const Snake *snake, unsigned int r);
+
+#endif /* SNAKE_H */
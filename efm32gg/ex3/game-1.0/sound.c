@@ -0,0 +1,204 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 1
+#define _GNU_SOURCE 1
+#endif /* _POSIX_C_SOURCE */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "sound.h"
+
+/* Songs started and not yet seen by the sound thread, must be a power of
+   two */
+#define COMMAND_QUEUE_SIZE 16
+#define COMMAND_QUEUE_MASK (COMMAND_QUEUE_SIZE - 1)
+
+typedef struct Command Command;
+
+struct Command
+{
+    int voice;
+    const Song *song;
+};
+
+static const SoundSink *sinks[] = {
+    &sound_null,
+    &sound_wav,
+#ifdef HAVE_ALSA
+    &sound_alsa,
+#endif
+};
+
+static const SoundSink *sink = NULL;
+
+/* Owned by the sound thread once it runs */
+static Synth synth;
+static pthread_t thread;
+static int running = 0;
+
+/* Single producer, single consumer queue from the game to the sound thread,
+   'command_head' is written by the game and 'command_tail' by the thread */
+static Command commands[COMMAND_QUEUE_SIZE];
+static uint32_t command_head = 0;
+static uint32_t command_tail = 0;
+
+/* Starts the songs queued since the last period */
+static void take_commands(void)
+{
+    uint32_t head = __atomic_load_n(&command_head, __ATOMIC_ACQUIRE);
+    uint32_t tail = command_tail;
+
+    for (; tail != head; tail++)
+        synth_play(&synth, commands[tail & COMMAND_QUEUE_MASK].voice,
+            commands[tail & COMMAND_QUEUE_MASK].song);
+
+    __atomic_store_n(&command_tail, tail, __ATOMIC_RELEASE);
+}
+
+/* Adds 'frames' samples worth of time to 't' */
+static void advance(struct timespec *t, long frames)
+{
+    int64_t ns = (int64_t)frames * 1000000000 / SOUND_RATE;
+
+    t->tv_sec += ns / 1000000000;
+    t->tv_nsec += ns % 1000000000;
+    if (t->tv_nsec >= 1000000000)
+    {
+        t->tv_nsec -= 1000000000;
+        t->tv_sec++;
+    }
+}
+
+/* Renders a period at a time until the sound is closed
+
+   Unpaced sinks are written on a clock started with the thread, each
+   period is due one period after the last rather than after the write, so
+   the time spent rendering does not add up.
+*/
+static void *sound_main(void *arg)
+{
+    int16_t samples[SOUND_PERIOD];
+    struct timespec start;
+    struct timespec due;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (long frames = 0; __atomic_load_n(&running, __ATOMIC_ACQUIRE);
+        frames += SOUND_PERIOD)
+    {
+        take_commands();
+        synth_render(&synth, samples, SOUND_PERIOD);
+
+        if (sink->write(samples, SOUND_PERIOD))
+            break;
+
+        if (!sink->paced)
+        {
+            due = start;
+            advance(&due, frames + SOUND_PERIOD);
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+/* Starts the sound thread, with real-time priority where it is allowed */
+static int start_thread(void)
+{
+    struct sched_param param;
+    pthread_attr_t attr;
+    sigset_t all;
+    sigset_t old;
+    int error;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    pthread_attr_setschedparam(&attr, &param);
+
+    /* Signals are left to the game */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+
+    error = pthread_create(&thread, &attr, sound_main, NULL);
+    if (error)
+    {
+        printf("No real-time priority for sound\n");
+        error = pthread_create(&thread, NULL, sound_main, NULL);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    pthread_attr_destroy(&attr);
+
+    return error;
+}
+
+/* Opens the sink called 'name' on 'path' and starts rendering into it
+
+   Returns 1 if there is no such sink or it fails to start.
+*/
+int sound_init(const char *name, const char *path)
+{
+    for (int i = 0; i < sizeof(sinks) / sizeof(sinks[0]); i++)
+        if (strcmp(sinks[i]->name, name) == 0)
+            sink = sinks[i];
+
+    if (sink == NULL)
+    {
+        printf("Unknown sound sink '%s'\n", name);
+        return 1;
+    }
+
+    if (sink->open(path, SOUND_RATE))
+    {
+        sink = NULL;
+        return 1;
+    }
+
+    synth_init(&synth, SOUND_RATE);
+    running = 1;
+
+    if (start_thread())
+    {
+        printf("Failed to start sound thread\n");
+        sink->close();
+        sink = NULL;
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Starts 'song' on 'voice' from the next period on, dropped if the sound
+   thread has fallen that far behind or there is no sound */
+void sound_play(int voice, const Song *song)
+{
+    uint32_t head = command_head;
+
+    if (sink == NULL ||
+        head - __atomic_load_n(&command_tail, __ATOMIC_ACQUIRE) ==
+        COMMAND_QUEUE_SIZE)
+        return;
+
+    commands[head & COMMAND_QUEUE_MASK].voice = voice;
+    commands[head & COMMAND_QUEUE_MASK].song = song;
+    __atomic_store_n(&command_head, head + 1, __ATOMIC_RELEASE);
+}
+
+void sound_close(void)
+{
+    if (sink == NULL)
+        return;
+
+    __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+    sink->close();
+    sink = NULL;
+}
@@ -0,0 +1,39 @@
+#ifndef SOUND_H
+#define SOUND_H
+
+#include <stdint.h>
+
+#include "synth.h"
+
+/* Output rate and the samples rendered per wakeup of the sound thread */
+#define SOUND_RATE 44100
+#define SOUND_PERIOD 256
+
+/* Voices used by the game */
+enum { SOUND_MUSIC, SOUND_EFFECT };
+
+typedef struct SoundSink SoundSink;
+
+/* Audio output, 'open' prepares 'path' or the sink's default output for
+   mono 16 bit samples at 'rate'. Sinks that are not 'paced' by a device
+   consuming samples in real time are paced by the sound thread's clock. */
+struct SoundSink
+{
+    const char *name;
+    int paced;
+    int (*open)(const char *path, uint32_t rate);
+    int (*write)(const int16_t *samples, int n);
+    void (*close)(void);
+};
+
+extern const SoundSink sound_null;
+extern const SoundSink sound_wav;
+#ifdef HAVE_ALSA
+extern const SoundSink sound_alsa;
+#endif
+
+int sound_init(const char *name, const char *path);
+void sound_play(int voice, const Song *song);
+void sound_close(void);
+
+#endif /* SOUND_H */
@@ -0,0 +1,205 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 1
+#define _GNU_SOURCE 1
+#endif /* _POSIX_C_SOURCE */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#ifdef HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+#include "sound.h"
+
+
+/*------------------------------------------------------------------------------
+ *
+ * Null sink
+ *
+ *----------------------------------------------------------------------------*/
+
+
+static int null_open(const char *path, uint32_t rate)
+{
+    return 0;
+}
+
+static int null_write(const int16_t *samples, int n)
+{
+    return 0;
+}
+
+static void null_close(void)
+{
+}
+
+const SoundSink sound_null = {
+    "null", 0, null_open, null_write, null_close
+};
+
+
+/*------------------------------------------------------------------------------
+ *
+ * WAV file sink
+ *
+ *----------------------------------------------------------------------------*/
+
+
+/* Size of the RIFF and format headers before the samples */
+#define WAV_HEADER_SIZE 44
+
+static FILE *wav_file = NULL;
+static uint32_t wav_bytes = 0;
+
+static void put_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t value)
+{
+    put_u16(p, value);
+    put_u16(p + 2, value >> 16);
+}
+
+/* Writes the header of a mono 16 bit PCM file of 'bytes' sample bytes */
+static void write_header(uint32_t rate, uint32_t bytes)
+{
+    uint8_t header[WAV_HEADER_SIZE] = "RIFF----WAVEfmt ";
+
+    put_u32(header + 4, WAV_HEADER_SIZE - 8 + bytes);
+    put_u32(header + 16, 16);
+    put_u16(header + 20, 1);
+    put_u16(header + 22, 1);
+    put_u32(header + 24, rate);
+    put_u32(header + 28, rate * 2);
+    put_u16(header + 32, 2);
+    put_u16(header + 34, 16);
+    put_u32(header + 36, 0x61746164);
+    put_u32(header + 40, bytes);
+
+    fwrite(header, 1, WAV_HEADER_SIZE, wav_file);
+}
+
+/* Creates the WAV file at 'path', game.wav by default, its sizes are
+   filled in when it is closed */
+static int wav_open(const char *path, uint32_t rate)
+{
+    if (path == NULL)
+        path = "game.wav";
+
+    wav_file = fopen(path, "wb");
+    if (wav_file == NULL)
+    {
+        printf("Failed to create %s\n", path);
+        return 1;
+    }
+
+    wav_bytes = 0;
+    write_header(rate, 0);
+
+    return 0;
+}
+
+static int wav_write(const int16_t *samples, int n)
+{
+    uint8_t bytes[2 * SOUND_PERIOD];
+
+    for (int i = 0; i < n; i++)
+        put_u16(bytes + 2 * i, samples[i]);
+
+    if (fwrite(bytes, 2, n, wav_file) != n)
+    {
+        printf("Failed writing sound\n");
+        return 1;
+    }
+
+    wav_bytes += 2 * n;
+    return 0;
+}
+
+static void wav_close(void)
+{
+    rewind(wav_file);
+    write_header(SOUND_RATE, wav_bytes);
+    fclose(wav_file);
+    wav_file = NULL;
+}
+
+const SoundSink sound_wav = {
+    "wav", 0, wav_open, wav_write, wav_close
+};
+
+
+/*------------------------------------------------------------------------------
+ *
+ * ALSA sink
+ *
+ *----------------------------------------------------------------------------*/
+
+
+#ifdef HAVE_ALSA
+
+/* Buffered audio, enough to ride out a few late periods */
+#define ALSA_LATENCY_US 50000
+
+static snd_pcm_t *pcm = NULL;
+
+/* Opens the PCM device 'path', the default one if it is NULL */
+static int alsa_open(const char *path, uint32_t rate)
+{
+    int error;
+
+    error = snd_pcm_open(&pcm, path ? path : "default",
+        SND_PCM_STREAM_PLAYBACK, 0);
+    if (error == 0)
+        error = snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16,
+            SND_PCM_ACCESS_RW_INTERLEAVED, 1, rate, 1, ALSA_LATENCY_US);
+
+    if (error < 0)
+    {
+        printf("Failed to open sound device: %s\n", snd_strerror(error));
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Blocks until the device has room, recovering from underruns */
+static int alsa_write(const int16_t *samples, int n)
+{
+    snd_pcm_sframes_t written;
+
+    while (n > 0)
+    {
+        written = snd_pcm_writei(pcm, samples, n);
+        if (written < 0)
+        {
+            if (snd_pcm_recover(pcm, written, 1) < 0)
+            {
+                printf("Failed writing sound: %s\n", snd_strerror(written));
+                return 1;
+            }
+            continue;
+        }
+        samples += written;
+        n -= written;
+    }
+
+    return 0;
+}
+
+static void alsa_close(void)
+{
+    snd_pcm_drain(pcm);
+    snd_pcm_close(pcm);
+    pcm = NULL;
+}
+
+const SoundSink sound_alsa = {
+    "alsa", 1, alsa_open, alsa_write, alsa_close
+};
+
+#endif /* HAVE_ALSA */
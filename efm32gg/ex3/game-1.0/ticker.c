@@ -0,0 +1,74 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 1
+#define _GNU_SOURCE 1
+#endif /* _POSIX_C_SOURCE */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "ticker.h"
+
+static int timer_fd = -1;
+
+/* Creates a periodic timer on CLOCK_MONOTONIC firing every 'period_ns' */
+int ticker_init(long period_ns)
+{
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+
+    if (timer_fd == -1)
+    {
+        printf("Failed to create tick timer\n");
+        return 1;
+    }
+
+    return ticker_set_period(period_ns);
+}
+
+/* Restarts the timer with a new period, the next tick is 'period_ns' away */
+int ticker_set_period(long period_ns)
+{
+    struct itimerspec spec;
+
+    spec.it_interval.tv_sec = period_ns / 1000000000L;
+    spec.it_interval.tv_nsec = period_ns % 1000000000L;
+    spec.it_value = spec.it_interval;
+
+    if (timerfd_settime(timer_fd, 0, &spec, NULL) == -1)
+    {
+        printf("Failed to set tick period\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Sleeps until the next tick
+
+   Returns the number of ticks that elapsed since the last call, which is
+   more than one when the caller overran a period.
+*/
+int ticker_wait(void)
+{
+    uint64_t expirations = 0;
+
+    while (read(timer_fd, &expirations, sizeof(expirations)) == -1)
+        if (errno != EINTR)
+            return 0;
+
+    return (int)expirations;
+}
+
+/* Returns the timer descriptor, readable once a tick is due */
+int ticker_fd(void)
+{
+    return timer_fd;
+}
+
+void ticker_close(void)
+{
+    close(timer_fd);
+    timer_fd = -1;
+}
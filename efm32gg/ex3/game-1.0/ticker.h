@@ -0,0 +1,10 @@
+#ifndef TICKER_H
+#define TICKER_H
+
+int ticker_init(long period_ns);
+int ticker_set_period(long period_ns);
+int ticker_wait(void);
+int ticker_fd(void);
+void ticker_close(void);
+
+#endif /* TICKER_H */
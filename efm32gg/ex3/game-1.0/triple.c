@@ -0,0 +1,41 @@
+#include "triple.h"
+
+/* Set in 'shared' while the slot it names has not been taken */
+#define TRIPLE_FRESH 4
+#define TRIPLE_SLOT  3
+
+void triple_init(TripleBuffer *buffer)
+{
+    buffer->back = 0;
+    buffer->shared = 1;
+    buffer->front = 2;
+}
+
+/* Publishes slot 'back' and continues in the slot it replaced, the writes to
+   the slot are visible to the reader once it takes it */
+void triple_publish(TripleBuffer *buffer)
+{
+    int previous = __atomic_exchange_n(&buffer->shared,
+        buffer->back | TRIPLE_FRESH, __ATOMIC_ACQ_REL);
+
+    buffer->back = previous & TRIPLE_SLOT;
+}
+
+/* Takes the latest published slot as 'front'
+
+   Returns 0 if nothing was published since the last call, 'front' is then
+   left unchanged.
+*/
+int triple_take(TripleBuffer *buffer)
+{
+    int previous;
+
+    if (!(__atomic_load_n(&buffer->shared, __ATOMIC_ACQUIRE) & TRIPLE_FRESH))
+        return 0;
+
+    previous = __atomic_exchange_n(&buffer->shared, buffer->front,
+        __ATOMIC_ACQ_REL);
+    buffer->front = previous & TRIPLE_SLOT;
+
+    return 1;
+}
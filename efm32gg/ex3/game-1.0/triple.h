@@ -0,0 +1,25 @@
+#ifndef TRIPLE_H
+#define TRIPLE_H
+
+typedef struct TripleBuffer TripleBuffer;
+
+/* Hands the latest of a stream of values from one writer thread to one
+   reader thread without locks
+
+   The values live in three slots owned by the caller. The writer fills
+   slot 'back' and publishes it, the reader takes the latest published slot
+   as 'front'. 'shared' holds the slot in between, with TRIPLE_FRESH set
+   while it has not been taken. Neither side ever waits for the other.
+*/
+struct TripleBuffer
+{
+    int shared;
+    int back;
+    int front;
+};
+
+void triple_init(TripleBuffer *buffer);
+void triple_publish(TripleBuffer *buffer);
+int triple_take(TripleBuffer *buffer);
+
+#endif /* TRIPLE_H */
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Prints the geckoboot boot timeline.
+
+Reads the "T" line geckoboot prints before starting Linux from a serial
+log, or the 32 byte timeline block at 0x1001ffe0 dumped from RAM with
+--raw. Cycle counts are converted with --hz, the core clock after reginit
+switches to HFXO; reginit itself mostly runs on the 14 MHz HFRCO.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+MAGIC = 0x53544247
+
+STAGES = [
+    "reginit",
+    "bcinit",
+    "level shifter delay",
+    "AUXHFRCO ready",
+    "start of DTB copy",
+    "end of DTB copy",
+    "jump to Linux",
+]
+
+LINE = re.compile(r"^T((?: [0-9a-f]{8}){%d})\s*$" % len(STAGES))
+
+
+def from_log(f):
+    """Returns the stamps of the last timeline in the log 'f'."""
+    stamps = None
+    for line in f:
+        m = LINE.match(line.strip("\r\n"))
+        if m:
+            stamps = [int(word, 16) for word in m.group(1).split()]
+    if stamps is None:
+        sys.exit("no boot timeline found")
+    return stamps
+
+
+def from_raw(path):
+    """Returns the stamps in the little endian timeline block at 'path'."""
+    with open(path, "rb") as f:
+        data = f.read(4 * (len(STAGES) + 1))
+    if len(data) < 4 * (len(STAGES) + 1):
+        sys.exit("timeline block too short")
+    words = struct.unpack("<%dI" % (len(STAGES) + 1), data)
+    if words[0] != MAGIC:
+        sys.exit("no boot timeline magic in %s" % path)
+    return list(words[1:])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", nargs="?", help="serial log, stdin if omitted")
+    parser.add_argument("--raw", help="timeline block dumped from RAM")
+    parser.add_argument("--hz", type=float, default=48e6,
+                        help="core clock in Hz, 48 MHz by default")
+    args = parser.parse_args()
+
+    if args.raw:
+        stamps = from_raw(args.raw)
+    elif args.log:
+        with open(args.log, errors="replace") as f:
+            stamps = from_log(f)
+    else:
+        stamps = from_log(sys.stdin)
+
+    ms = 1000.0 / args.hz
+    last = 0
+    print("%-22s %12s %10s %10s" % ("stage", "cycles", "stage ms", "total ms"))
+    for name, stamp in zip(STAGES, stamps):
+        if stamp == 0:
+            print("%-22s %12s" % (name, "skipped"))
+            continue
+        print("%-22s %12d %10.3f %10.3f" %
+              (name, stamp, (stamp - last) * ms, stamp * ms))
+        last = stamp
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,147 @@
+#include <string.h>
+
+#include "synth.h"
+
+/* Peak of a voice, leaves headroom for mixing all of them at full volume */
+#define VOICE_AMPLITUDE 8192
+
+/* Samples mixed at a time */
+#define SYNTH_BLOCK 64
+
+/* Starts note 'index' of the song on 'voice', wrapping around looped songs
+
+   Returns 1 once the song is over.
+*/
+static int start_note(const Synth *synth, Voice *voice, int index)
+{
+    const Note *note;
+
+    if (index >= voice->song->length)
+    {
+        if (!voice->song->loop || voice->song->length == 0)
+        {
+            voice->song = NULL;
+            return 1;
+        }
+        index = 0;
+    }
+
+    note = &voice->song->notes[index];
+    voice->note = index;
+    voice->left = synth->rate * note->duration / 1000;
+    if (voice->left == 0)
+        voice->left = 1;
+    voice->increment = note->frequency * synth->phase_per_hz;
+
+    return 0;
+}
+
+/* Adds 'n' samples of 'voice' to 'mix'
+
+   Notes are rendered in runs up to the next note boundary, so the inner
+   loops only step the phase accumulator.
+*/
+static void render_voice(const Synth *synth, Voice *voice, int32_t *mix,
+    int n)
+{
+    uint32_t phase = voice->phase;
+    uint32_t increment;
+    int run;
+    int i = 0;
+
+    while (i < n && voice->song != NULL)
+    {
+        if (voice->left == 0 && start_note(synth, voice, voice->note + 1))
+            break;
+
+        run = n - i;
+        if ((uint32_t)run > voice->left)
+            run = voice->left;
+        increment = voice->increment;
+
+        if (increment == 0)
+            ;
+        else if (voice->song->wave == WAVE_SQUARE)
+        {
+            for (int k = i; k < i + run; k++, phase += increment)
+                mix[k] += (((int32_t)phase >> 31) | 1) * VOICE_AMPLITUDE;
+        }
+        else
+        {
+            for (int k = i; k < i + run; k++, phase += increment)
+                mix[k] += (int32_t)phase >> 18;
+        }
+
+        i += run;
+        voice->left -= run;
+    }
+
+    voice->phase = phase;
+}
+
+/* Sets up 'synth' to render at 'rate' samples per second, silent and at
+   full volume */
+void synth_init(Synth *synth, uint32_t rate)
+{
+    memset(synth, 0, sizeof(*synth));
+    synth->rate = rate;
+    synth->phase_per_hz = 0xffffffffU / rate;
+    synth->volume = SYNTH_VOLUME_MAX;
+}
+
+/* Sets the output gain, from 0 to SYNTH_VOLUME_MAX */
+void synth_set_volume(Synth *synth, int volume)
+{
+    if (volume < 0)
+        volume = 0;
+    if (volume > SYNTH_VOLUME_MAX)
+        volume = SYNTH_VOLUME_MAX;
+
+    synth->volume = volume;
+}
+
+/* Starts 'song' from its beginning on 'voice', NULL silences the voice */
+void synth_play(Synth *synth, int voice, const Song *song)
+{
+    Voice *v = &synth->voices[voice];
+
+    v->song = song;
+    v->note = -1;
+    v->left = 0;
+}
+
+/* Returns 1 while 'voice' has a song to play */
+int synth_playing(const Synth *synth, int voice)
+{
+    return synth->voices[voice].song != NULL;
+}
+
+/* Renders the next 'n_frames' mono samples of all voices into 'buffer' */
+void synth_render(Synth *synth, int16_t *buffer, int n_frames)
+{
+    int32_t mix[SYNTH_BLOCK];
+    int32_t sample;
+    int n;
+
+    while (n_frames > 0)
+    {
+        n = n_frames < SYNTH_BLOCK ? n_frames : SYNTH_BLOCK;
+        memset(mix, 0, n * sizeof(int32_t));
+
+        for (int v = 0; v < SYNTH_VOICES; v++)
+            render_voice(synth, &synth->voices[v], mix, n);
+
+        for (int i = 0; i < n; i++)
+        {
+            sample = mix[i] * synth->volume >> 8;
+            if (sample > INT16_MAX)
+                sample = INT16_MAX;
+            if (sample < INT16_MIN)
+                sample = INT16_MIN;
+            buffer[i] = sample;
+        }
+
+        buffer += n;
+        n_frames -= n;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stdint.h>
+
+/* Voices mixed, e.g. music and sound effects */
+#define SYNTH_VOICES 2
+
+/* Full volume */
+#define SYNTH_VOLUME_MAX 256
+
+enum { WAVE_SQUARE, WAVE_SAW };
+
+typedef struct Note Note;
+typedef struct Song Song;
+typedef struct Voice Voice;
+typedef struct Synth Synth;
+
+/* Tone of 'frequency' Hz held for 'duration' ms, a frequency of 0 rests */
+struct Note
+{
+    uint16_t frequency;
+    uint16_t duration;
+};
+
+struct Song
+{
+    const Note *notes;
+    int length;
+    int wave;
+    int loop;
+};
+
+/* Playback state of one song, the oscillator phase wraps once per period */
+struct Voice
+{
+    const Song *song;
+    int note;
+    uint32_t left;
+    uint32_t phase;
+    uint32_t increment;
+};
+
+struct Synth
+{
+    uint32_t rate;
+    uint32_t phase_per_hz;
+    int volume;
+    Voice voices[SYNTH_VOICES];
+};
+
+void synth_init(Synth *synth, uint32_t rate);
+void synth_set_volume(Synth *synth, int volume);
+void synth_play(Synth *synth, int voice, const Song *song);
+int synth_playing(const Synth *synth, int voice);
+void synth_render(Synth *synth, int16_t *buffer, int n_frames);
+
+#endif /* SYNTH_H */